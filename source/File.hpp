@@ -56,6 +56,11 @@ namespace azura {
         virtual int  write(const u8* buffer, int size) = 0;
         virtual bool flush() = 0;
 
+        // returns a pointer to the next size bytes and skips them, if the
+        // file can expose its data without copying; otherwise returns null
+        // and leaves the position untouched
+        virtual const u8* view(int size) { (void)size; return 0; }
+
     protected:
         virtual ~File() { }
     };
@@ -42,6 +42,7 @@ namespace azura {
             BGR      =  2,
             RGBA     =  3,
             BGRA     =  4,
+            RGBA_P8  =  5,
             Count,
         };
     };
@@ -74,6 +75,10 @@ namespace azura {
         virtual RGB* getPalette() = 0;
         virtual void setPalette(const RGB palette[256]) = 0;
 
+        virtual const RGBA* getAlphaPalette() const = 0;
+        virtual RGBA* getAlphaPalette() = 0;
+        virtual void setAlphaPalette(const RGBA palette[256]) = 0;
+
         virtual Image::Ptr convert(PixelFormat::Enum pf) = 0;
 
     protected:
@@ -0,0 +1,82 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_PLANARIMAGE_HPP_INCLUDED
+#define AZURA_PLANARIMAGE_HPP_INCLUDED
+
+#include "RefCounted.hpp"
+#include "RefPtr.hpp"
+#include "types.hpp"
+#include "Image.hpp"
+
+
+namespace azura {
+
+    struct PlanarFormat {
+        enum Enum {
+            Unknown = -1,
+            Y8      =  0,
+            YUV444  =  1,
+            YUV422  =  2,
+            YUV420  =  3,
+            YUV440  =  4,
+            YUV411  =  5,
+            Count,
+        };
+    };
+
+    struct PlanarFormatDescriptor {
+        u8 planeCount;
+        u8 chromaShiftX;
+        u8 chromaShiftY;
+    };
+
+    class PlanarImage : public RefCounted {
+    public:
+        typedef RefPtr<PlanarImage> Ptr;
+
+        static const PlanarFormatDescriptor& GetPlanarFormatDescriptor(PlanarFormat::Enum pf);
+
+        virtual int getWidth() const = 0;
+        virtual int getHeight() const = 0;
+        virtual PlanarFormat::Enum getPlanarFormat() const = 0;
+
+        virtual int getPlaneCount() const = 0;
+        virtual int getPlaneWidth(int plane) const = 0;
+        virtual int getPlaneHeight(int plane) const = 0;
+        virtual int getPlanePitch(int plane) const = 0;
+
+        virtual const u8* getPlane(int plane) const = 0;
+        virtual u8* getPlane(int plane) = 0;
+
+        virtual Image::Ptr convert(PixelFormat::Enum pf) = 0;
+
+    protected:
+        virtual ~PlanarImage() { }
+    };
+
+}
+
+
+#endif
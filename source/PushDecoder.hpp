@@ -0,0 +1,73 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_PUSHDECODER_HPP_INCLUDED
+#define AZURA_PUSHDECODER_HPP_INCLUDED
+
+#include "RefCounted.hpp"
+#include "RefPtr.hpp"
+#include "types.hpp"
+#include "Image.hpp"
+
+
+namespace azura {
+
+    // decodes an image from data that arrives in chunks of any size,
+    // making every row available as soon as it has been decoded
+    class PushDecoder : public RefCounted {
+    public:
+        typedef RefPtr<PushDecoder> Ptr;
+
+        // receives the decoding progress, all calls happen from within push()
+        class Listener {
+        public:
+            virtual ~Listener() { }
+
+            // the header has been decoded and the image allocated
+            virtual void onHeader(PushDecoder* decoder, Image* image) { (void)decoder; (void)image; }
+
+            // row y has been decoded; interlaced images deliver their
+            // rows several times, with increasing pass numbers
+            virtual void onRow(PushDecoder* decoder, int y, int pass) { (void)decoder; (void)y; (void)pass; }
+
+            // the whole image has been decoded
+            virtual void onComplete(PushDecoder* decoder) { (void)decoder; }
+        };
+
+        // feeds the next chunk of data, returns false once decoding failed
+        virtual bool push(const u8* data, int size) = 0;
+
+        virtual bool isComplete() const = 0;
+        virtual bool hasFailed() const = 0;
+
+        // the image being decoded, null until the header is available
+        virtual Image::Ptr getImage() = 0;
+
+    protected:
+        virtual ~PushDecoder() { }
+    };
+
+}
+
+
+#endif
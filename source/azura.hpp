@@ -30,9 +30,14 @@
 #include "platform.hpp"
 #include "types.hpp"
 #include "version.hpp"
+#include "cpu.hpp"
 #include "File.hpp"
 #include "MemoryFile.hpp"
 #include "Image.hpp"
+#include "PlanarImage.hpp"
+#include "PushDecoder.hpp"
+#include "quantize.hpp"
+#include "options.hpp"
 
 
 namespace azura {
@@ -52,6 +57,18 @@ namespace azura {
 
     AZURAAPI int GetVersionNumber();
 
+    AZURAAPI int GetCpuFeatures();
+
+    AZURAAPI int GetKernelCount();
+
+    AZURAAPI std::string GetKernelName(int index);
+
+    AZURAAPI std::string GetKernelPath(int index);
+
+    AZURAAPI void SetThreadCount(int count);
+
+    AZURAAPI int GetThreadCount();
+
     AZURAAPI File::Ptr OpenFile(const std::string& filename, File::OpenMode mode = File::In);
 
     AZURAAPI MemoryFile::Ptr CreateMemoryFile(int capacity = 0);
@@ -60,13 +77,29 @@ namespace azura {
 
     AZURAAPI Image::Ptr CreateImage(int width, int height, PixelFormat::Enum pf, const u8* pixels = 0, const RGB palette[256] = 0);
 
-    AZURAAPI Image::Ptr ReadImage(File* file, FileFormat::Enum ff = FileFormat::AutoDetect, PixelFormat::Enum pf = PixelFormat::DontCare);
+    // like CreateImage(), for formats with an RGBA palette such as RGBA_P8
+    AZURAAPI Image::Ptr CreateAlphaPaletteImage(int width, int height, PixelFormat::Enum pf, const u8* pixels = 0, const RGBA palette[256] = 0);
+
+    AZURAAPI Image::Ptr QuantizeImage(Image* image, PixelFormat::Enum pf = PixelFormat::RGB_P8, const QuantizeOptions& options = QuantizeOptions(), QuantizeStats* stats = 0);
+
+    AZURAAPI PaletteBuilder::Ptr CreatePaletteBuilder(const QuantizeOptions& options = QuantizeOptions());
+
+    AZURAAPI Image::Ptr MapImageToPalette(Image* image, const RGB* palette, int colorCount = 256, PixelFormat::Enum pf = PixelFormat::RGB_P8);
+
+    AZURAAPI Image::Ptr ReadImage(File* file, FileFormat::Enum ff = FileFormat::AutoDetect, PixelFormat::Enum pf = PixelFormat::DontCare, const ReadOptions& options = ReadOptions());
+
+    AZURAAPI Image::Ptr ReadImage(const std::string& filename, FileFormat::Enum ff = FileFormat::AutoDetect, PixelFormat::Enum pf = PixelFormat::DontCare, const ReadOptions& options = ReadOptions());
+
+    AZURAAPI PlanarImage::Ptr ReadPlanarImage(File* file, FileFormat::Enum ff = FileFormat::AutoDetect);
+
+    AZURAAPI PlanarImage::Ptr ReadPlanarImage(const std::string& filename, FileFormat::Enum ff = FileFormat::AutoDetect);
 
-    AZURAAPI Image::Ptr ReadImage(const std::string& filename, FileFormat::Enum ff = FileFormat::AutoDetect, PixelFormat::Enum pf = PixelFormat::DontCare);
+    // only PNG images can be decoded incrementally for now
+    AZURAAPI PushDecoder::Ptr CreatePushDecoder(FileFormat::Enum ff, PushDecoder::Listener* listener = 0);
 
-    AZURAAPI bool WriteImage(Image* image, File* file, FileFormat::Enum ff);
+    AZURAAPI bool WriteImage(Image* image, File* file, FileFormat::Enum ff, const WriteOptions& options = WriteOptions());
 
-    AZURAAPI bool WriteImage(Image* image, const std::string& filename, FileFormat::Enum ff = FileFormat::AutoDetect);
+    AZURAAPI bool WriteImage(Image* image, const std::string& filename, FileFormat::Enum ff = FileFormat::AutoDetect, const WriteOptions& options = WriteOptions());
 
 }
 
@@ -26,6 +26,7 @@
 #define AZURA_ARRAYAUTOPTR_HPP_INCLUDED
 
 #include <cassert>
+#include <cstddef>
 
 
 namespace azura {
@@ -37,6 +37,7 @@ namespace azura {
             { true,   false,  3,  2,  1,  0,  0 }, // BGR
             { true,   true,   4,  0,  1,  2,  3 }, // RGBA
             { true,   true,   4,  2,  1,  0,  3 }, // BGRA
+            { false,  true,   1,  0,  0,  0,  0 }, // RGBA_P8
         };
 
     }
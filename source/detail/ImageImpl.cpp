@@ -25,8 +25,10 @@
 #include <cassert>
 #include <cstring>
 
+#include "../azura.hpp"
+
 #include "ImageImpl.hpp"
-#include "octreequant.hpp"
+#include "kernels.hpp"
 
 
 namespace azura {
@@ -38,6 +40,7 @@ namespace azura {
         , _pixelFormat(pf)
         , _pixels(0)
         , _palette(0)
+        , _alphaPalette(0)
     {
         assert(width > 0);
         assert(height > 0);
@@ -49,8 +52,13 @@ namespace azura {
         std::memset(_pixels, 0x00, width * height * pfd.bytesPerPixel);
 
         if (!pfd.isDirectColor) {
-            _palette = new RGB[256];
-            std::memset(_palette, 0x00, 256 * sizeof(RGB));
+            if (pfd.hasAlpha) {
+                _alphaPalette = new RGBA[256];
+                std::memset(_alphaPalette, 0x00, 256 * sizeof(RGBA));
+            } else {
+                _palette = new RGB[256];
+                std::memset(_palette, 0x00, 256 * sizeof(RGB));
+            }
         }
     }
 
@@ -62,6 +70,28 @@ namespace azura {
         if (_palette) {
             delete[] _palette;
         }
+
+        if (_alphaPalette) {
+            delete[] _alphaPalette;
+        }
+    }
+
+    //--------------------------------------------------------------
+    RGBA
+    ImageImpl::getPaletteEntry(int index) const
+    {
+        RGBA col;
+
+        if (_alphaPalette) {
+            col = _alphaPalette[index];
+        } else {
+            col.red   = _palette[index].red;
+            col.green = _palette[index].green;
+            col.blue  = _palette[index].blue;
+            col.alpha = 255;
+        }
+
+        return col;
     }
 
     //--------------------------------------------------------------
@@ -137,6 +167,32 @@ namespace azura {
         }
     }
 
+    //--------------------------------------------------------------
+    const RGBA*
+    ImageImpl::getAlphaPalette() const
+    {
+        return _alphaPalette;
+    }
+
+    //--------------------------------------------------------------
+    RGBA*
+    ImageImpl::getAlphaPalette()
+    {
+        return _alphaPalette;
+    }
+
+    //--------------------------------------------------------------
+    void
+    ImageImpl::setAlphaPalette(const RGBA palette[256])
+    {
+        assert(_alphaPalette);
+        assert(palette);
+
+        if (_alphaPalette && palette) {
+            std::memcpy(_alphaPalette, palette, 256 * sizeof(RGBA));
+        }
+    }
+
     //--------------------------------------------------------------
     Image::Ptr
     ImageImpl::convert(PixelFormat::Enum pf)
@@ -158,62 +214,57 @@ namespace azura {
         {
             RefPtr<ImageImpl> result = new ImageImpl(_width, _height, pf);
 
-            u8* sptr = _pixels;
-            u8* dptr = result->_pixels;
+            GetKernels().swizzlePixels(_pixels, spfd, result->_pixels, dpfd, _width * _height);
+
+            return result;
+        }
+        else if (!spfd.isDirectColor && dpfd.isDirectColor)
+        {
+            RefPtr<ImageImpl> result = new ImageImpl(_width, _height, pf);
 
-            for (int i = _width * _height; i > 0; i--) {
-                dptr[dpfd.redMask]   = sptr[spfd.redMask];
-                dptr[dpfd.greenMask] = sptr[spfd.greenMask];
-                dptr[dpfd.blueMask]  = sptr[spfd.blueMask];
+            // build a lookup table holding each palette entry
+            // already laid out in the destination pixel format
+            u8 table[256][4];
+
+            for (int i = 0; i < 256; i++) {
+                RGBA col = getPaletteEntry(i);
+
+                table[i][dpfd.redMask]   = col.red;
+                table[i][dpfd.greenMask] = col.green;
+                table[i][dpfd.blueMask]  = col.blue;
 
                 if (dpfd.hasAlpha) {
-                    if (spfd.hasAlpha) {
-                        dptr[dpfd.alphaMask] = sptr[spfd.alphaMask];
-                    } else {
-                        dptr[dpfd.alphaMask] = 255;
-                    }
+                    table[i][dpfd.alphaMask] = col.alpha;
                 }
-
-                sptr += spfd.bytesPerPixel;
-                dptr += dpfd.bytesPerPixel;
             }
 
+            GetKernels().expandIndexed(_pixels, _width * _height, table, dpfd.bytesPerPixel, result->_pixels);
+
             return result;
         }
-        else if (!spfd.isDirectColor && dpfd.isDirectColor)
+        else if (!spfd.isDirectColor && !dpfd.isDirectColor)
         {
+            // the pixels stay the same, only the palette needs converting
             RefPtr<ImageImpl> result = new ImageImpl(_width, _height, pf);
+            result->setPixels(_pixels);
 
-            u8* sptr = _pixels;
-            RGB* splt = _palette;
-            u8* dptr = result->_pixels;
-
-            for (int i = _width * _height; i > 0; i--) {
-                RGB col = splt[*sptr];
-
-                dptr[dpfd.redMask]   = col.red;
-                dptr[dpfd.greenMask] = col.green;
-                dptr[dpfd.blueMask]  = col.blue;
+            for (int i = 0; i < 256; i++) {
+                RGBA col = getPaletteEntry(i);
 
                 if (dpfd.hasAlpha) {
-                    dptr[dpfd.alphaMask] = 255;
+                    result->_alphaPalette[i] = col;
+                } else {
+                    result->_palette[i].red   = col.red;
+                    result->_palette[i].green = col.green;
+                    result->_palette[i].blue  = col.blue;
                 }
-
-                sptr += spfd.bytesPerPixel;
-                dptr += dpfd.bytesPerPixel;
             }
 
             return result;
         }
         else if (spfd.isDirectColor && !dpfd.isDirectColor)
         {
-            // color quantization requires source pixels in RGB format
-            Image::Ptr rgb_image = convert(PixelFormat::RGB);
-
-            Image::Ptr plt_image = new ImageImpl(_width, _height, pf);
-            OctreeQuant((RGB*)rgb_image->getPixels(), _width * _height, plt_image->getPixels(), plt_image->getPalette());
-
-            return plt_image;
+            return QuantizeImage(this, pf);
         }
 
         // no suitable conversion available
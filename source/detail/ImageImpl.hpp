@@ -47,14 +47,22 @@ namespace azura {
         RGB* getPalette();
         void setPalette(const RGB palette[256]);
 
+        const RGBA* getAlphaPalette() const;
+        RGBA* getAlphaPalette();
+        void setAlphaPalette(const RGBA palette[256]);
+
         Image::Ptr convert(PixelFormat::Enum pf);
 
+    private:
+        RGBA getPaletteEntry(int index) const;
+
     private:
         int _width;
         int _height;
         PixelFormat::Enum _pixelFormat;
         u8* _pixels;
         RGB* _palette;
+        RGBA* _alphaPalette;
     };
 
 }
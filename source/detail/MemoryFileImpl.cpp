@@ -244,4 +244,17 @@ namespace azura {
         return true;
     }
 
+    //-----------------------------------------------------------------
+    const u8*
+    MemoryFileImpl::view(int size)
+    {
+        assert(size >= 0);
+        if (_eof || size > _size - _spos) {
+            return 0;
+        }
+        const u8* data = _buffer.getBuffer() + _spos;
+        _spos += size;
+        return data;
+    }
+
 }
@@ -54,6 +54,7 @@ namespace azura {
         int  read(u8* buffer, int bufferSize);
         int  write(const u8* buffer, int bufferSize);
         bool flush();
+        const u8* view(int size);
 
     private:
         ByteArray _buffer;
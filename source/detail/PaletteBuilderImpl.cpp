@@ -0,0 +1,187 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include <cstring>
+
+#include "PaletteBuilderImpl.hpp"
+#include "ImageImpl.hpp"
+#include "ArrayAutoPtr.hpp"
+#include "thread.hpp"
+
+
+namespace azura {
+
+    namespace {
+
+        // each part maps one whole image
+        class MapImagesTask : public ParallelTask {
+        public:
+            MapImagesTask(Quantizer* quantizer, Image** sources, Image** results)
+                : _quantizer(quantizer), _sources(sources), _results(results)
+            {
+            }
+
+            void run(int part) {
+                Image* src = _sources[part];
+                Image* dst = _results[part];
+
+                if (src && dst) {
+                    int count = src->getWidth() * src->getHeight();
+                    _quantizer->mapPixels((const RGB*)src->getPixels(), count, dst->getPixels());
+                }
+            }
+
+        private:
+            Quantizer* _quantizer;
+            Image** _sources;
+            Image** _results;
+        };
+
+    }
+
+    //--------------------------------------------------------------
+    PaletteBuilderImpl::PaletteBuilderImpl(Quantizer* quantizer, const QuantizeOptions& options)
+        : _quantizer(quantizer)
+        , _options(options)
+        , _colorCount(0)
+    {
+        std::memset(_palette, 0, sizeof(_palette));
+    }
+
+    //--------------------------------------------------------------
+    PaletteBuilderImpl::~PaletteBuilderImpl()
+    {
+    }
+
+    //--------------------------------------------------------------
+    bool
+    PaletteBuilderImpl::addImage(Image* image)
+    {
+        if (!image) {
+            return false;
+        }
+
+        Image::Ptr rgb_image = image->convert(PixelFormat::RGB);
+        if (!rgb_image) {
+            return false;
+        }
+
+        AddPixels(_quantizer.get(), (const RGB*)rgb_image->getPixels(), image->getWidth(), image->getHeight(), _options);
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    int
+    PaletteBuilderImpl::buildPalette()
+    {
+        std::memset(_palette, 0, sizeof(_palette));
+        _colorCount = _quantizer->buildPalette(_palette);
+        return _colorCount;
+    }
+
+    //--------------------------------------------------------------
+    const RGB*
+    PaletteBuilderImpl::getPalette() const
+    {
+        return _palette;
+    }
+
+    //--------------------------------------------------------------
+    int
+    PaletteBuilderImpl::getColorCount() const
+    {
+        return _colorCount;
+    }
+
+    //--------------------------------------------------------------
+    Image::Ptr
+    PaletteBuilderImpl::mapImage(Image* image, PixelFormat::Enum pf)
+    {
+        Image::Ptr result;
+        mapImages(&image, 1, &result, pf);
+        return result;
+    }
+
+    //--------------------------------------------------------------
+    bool
+    PaletteBuilderImpl::mapImages(Image** images, int count, Image::Ptr* results, PixelFormat::Enum pf)
+    {
+        if (!images || !results || count <= 0 || pf < 0 || pf >= PixelFormat::Count) {
+            return false;
+        }
+
+        if (_colorCount == 0 || Image::GetPixelFormatDescriptor(pf).isDirectColor) {
+            // no palette has been built, or no indexed format requested
+            return false;
+        }
+
+        // all reference counting happens here, the worker threads only
+        // see raw pointers
+        ArrayAutoPtr<Image::Ptr> sources = new Image::Ptr[count];
+        ArrayAutoPtr<Image*> raw_sources = new Image*[count];
+        ArrayAutoPtr<Image*> raw_results = new Image*[count];
+
+        for (int i = 0; i < count; i++) {
+            results[i] = 0;
+            raw_sources[i] = 0;
+            raw_results[i] = 0;
+
+            if (images[i]) {
+                sources[i] = images[i]->convert(PixelFormat::RGB);
+            }
+
+            if (sources[i]) {
+                results[i] = new ImageImpl(images[i]->getWidth(), images[i]->getHeight(), PixelFormat::RGB_P8);
+                results[i]->setPalette(_palette);
+
+                raw_sources[i] = sources[i].get();
+                raw_results[i] = results[i].get();
+            }
+        }
+
+        if (count == 1) {
+            // a single image is split into bands instead
+            if (raw_results[0]) {
+                int pixels_count = raw_sources[0]->getWidth() * raw_sources[0]->getHeight();
+                MapPixels(_quantizer.get(), (const RGB*)raw_sources[0]->getPixels(), pixels_count, raw_results[0]->getPixels());
+            }
+        } else {
+            MapImagesTask task(_quantizer.get(), raw_sources.get(), raw_results.get());
+            RunParallel(task, count);
+        }
+
+        bool succeeded = true;
+
+        for (int i = 0; i < count; i++) {
+            if (!results[i]) {
+                succeeded = false;
+            } else if (pf != PixelFormat::RGB_P8) {
+                // the palette is fully opaque
+                results[i] = results[i]->convert(pf);
+            }
+        }
+
+        return succeeded;
+    }
+
+}
@@ -0,0 +1,57 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_PALETTEBUILDERIMPL_HPP_INCLUDED
+#define AZURA_PALETTEBUILDERIMPL_HPP_INCLUDED
+
+#include "../quantize.hpp"
+#include "quantize.hpp"
+
+
+namespace azura {
+
+    class PaletteBuilderImpl : public PaletteBuilder {
+    public:
+        PaletteBuilderImpl(Quantizer* quantizer, const QuantizeOptions& options);
+        ~PaletteBuilderImpl();
+
+        bool addImage(Image* image);
+        int buildPalette();
+
+        const RGB* getPalette() const;
+        int getColorCount() const;
+
+        Image::Ptr mapImage(Image* image, PixelFormat::Enum pf);
+        bool mapImages(Image** images, int count, Image::Ptr* results, PixelFormat::Enum pf);
+
+    private:
+        Quantizer::Ptr _quantizer;
+        QuantizeOptions _options;
+        RGB _palette[256];
+        int _colorCount;
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,52 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <cassert>
+
+#include "../PlanarImage.hpp"
+
+
+namespace azura {
+
+    namespace {
+
+        PlanarFormatDescriptor PlanarFormatDescriptors[] = {
+            { 1,  0,  0 }, // Y8
+            { 3,  0,  0 }, // YUV444
+            { 3,  1,  0 }, // YUV422
+            { 3,  1,  1 }, // YUV420
+            { 3,  0,  1 }, // YUV440
+            { 3,  2,  0 }, // YUV411
+        };
+
+    }
+
+    const PlanarFormatDescriptor&
+    PlanarImage::GetPlanarFormatDescriptor(PlanarFormat::Enum pf)
+    {
+        assert(pf >= 0 && pf < PlanarFormat::Count);
+        return PlanarFormatDescriptors[pf];
+    }
+
+}
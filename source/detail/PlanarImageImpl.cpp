@@ -0,0 +1,245 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <cassert>
+#include <cstring>
+
+#include "PlanarImageImpl.hpp"
+#include "ImageImpl.hpp"
+
+
+namespace azura {
+
+    namespace {
+
+        inline u8 clamp_u8(int n)
+        {
+            return (u8)(n < 0 ? 0 : (n > 255 ? 255 : n));
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    PlanarImageImpl::PlanarImageImpl(int width, int height, PlanarFormat::Enum pf)
+        : _width(width)
+        , _height(height)
+        , _planarFormat(pf)
+        , _planeCount(0)
+    {
+        assert(width > 0);
+        assert(height > 0);
+        assert(pf >= 0 && pf < PlanarFormat::Count);
+
+        PlanarFormatDescriptor pfd = GetPlanarFormatDescriptor(pf);
+
+        _planeCount = pfd.planeCount;
+
+        // pad the planes to whole 8x8 blocks of chroma samples,
+        // which lets block based decoders write straight into them
+        int block_w = 8 << pfd.chromaShiftX;
+        int block_h = 8 << pfd.chromaShiftY;
+        int padded_w = (width  + block_w - 1) / block_w * block_w;
+        int padded_h = (height + block_h - 1) / block_h * block_h;
+
+        for (int i = 0; i < 3; i++) {
+            _planeWidth[i]  = 0;
+            _planeHeight[i] = 0;
+            _planePitch[i]  = 0;
+            _planeRows[i]   = 0;
+            _planes[i]      = 0;
+        }
+
+        for (int i = 0; i < _planeCount; i++) {
+            int shift_x = (i == 0 ? 0 : pfd.chromaShiftX);
+            int shift_y = (i == 0 ? 0 : pfd.chromaShiftY);
+
+            _planeWidth[i]  = (width  + (1 << shift_x) - 1) >> shift_x;
+            _planeHeight[i] = (height + (1 << shift_y) - 1) >> shift_y;
+            _planePitch[i]  = padded_w >> shift_x;
+            _planeRows[i]   = padded_h >> shift_y;
+
+            _planes[i] = new u8[_planePitch[i] * _planeRows[i]];
+            std::memset(_planes[i], 0x00, _planePitch[i] * _planeRows[i]);
+        }
+    }
+
+    //--------------------------------------------------------------
+    PlanarImageImpl::~PlanarImageImpl()
+    {
+        for (int i = 0; i < _planeCount; i++) {
+            delete[] _planes[i];
+        }
+    }
+
+    //--------------------------------------------------------------
+    int
+    PlanarImageImpl::getWidth() const
+    {
+        return _width;
+    }
+
+    //--------------------------------------------------------------
+    int
+    PlanarImageImpl::getHeight() const
+    {
+        return _height;
+    }
+
+    //--------------------------------------------------------------
+    PlanarFormat::Enum
+    PlanarImageImpl::getPlanarFormat() const
+    {
+        return _planarFormat;
+    }
+
+    //--------------------------------------------------------------
+    int
+    PlanarImageImpl::getPlaneCount() const
+    {
+        return _planeCount;
+    }
+
+    //--------------------------------------------------------------
+    int
+    PlanarImageImpl::getPlaneWidth(int plane) const
+    {
+        assert(plane >= 0 && plane < _planeCount);
+        return _planeWidth[plane];
+    }
+
+    //--------------------------------------------------------------
+    int
+    PlanarImageImpl::getPlaneHeight(int plane) const
+    {
+        assert(plane >= 0 && plane < _planeCount);
+        return _planeHeight[plane];
+    }
+
+    //--------------------------------------------------------------
+    int
+    PlanarImageImpl::getPlanePitch(int plane) const
+    {
+        assert(plane >= 0 && plane < _planeCount);
+        return _planePitch[plane];
+    }
+
+    //--------------------------------------------------------------
+    const u8*
+    PlanarImageImpl::getPlane(int plane) const
+    {
+        assert(plane >= 0 && plane < _planeCount);
+        return _planes[plane];
+    }
+
+    //--------------------------------------------------------------
+    u8*
+    PlanarImageImpl::getPlane(int plane)
+    {
+        assert(plane >= 0 && plane < _planeCount);
+        return _planes[plane];
+    }
+
+    //--------------------------------------------------------------
+    Image::Ptr
+    PlanarImageImpl::convert(PixelFormat::Enum pf)
+    {
+        if (pf < 0 || pf >= PixelFormat::Count) {
+            // invalid pixel format requested
+            return 0;
+        }
+
+        PixelFormatDescriptor dpfd = Image::GetPixelFormatDescriptor(pf);
+
+        if (!dpfd.isDirectColor) {
+            // go through RGB and let the image quantize the colors
+            Image::Ptr rgb_image = convert(PixelFormat::RGB);
+            if (!rgb_image) {
+                return 0;
+            }
+            return rgb_image->convert(pf);
+        }
+
+        PlanarFormatDescriptor spfd = GetPlanarFormatDescriptor(_planarFormat);
+
+        // JFIF YCbCr to RGB conversion tables (16.16 fixed point)
+        int cr_r[256];
+        int cb_b[256];
+        int cr_g[256];
+        int cb_g[256];
+
+        for (int i = 0; i < 256; i++) {
+            int c = i - 128;
+            cr_r[i] = ( 91881 * c + 32768) >> 16; // 1.40200
+            cb_b[i] = (116130 * c + 32768) >> 16; // 1.77200
+            cr_g[i] = -46802 * c;                 // 0.71414
+            cb_g[i] = -22554 * c + 32768;         // 0.34414
+        }
+
+        RefPtr<ImageImpl> result = new ImageImpl(_width, _height, pf);
+        u8* dptr = result->getPixels();
+
+        for (int y = 0; y < _height; y++) {
+            const u8* yrow = _planes[0] + y * _planePitch[0];
+
+            if (_planeCount == 1) {
+                for (int x = 0; x < _width; x++) {
+                    dptr[dpfd.redMask]   = yrow[x];
+                    dptr[dpfd.greenMask] = yrow[x];
+                    dptr[dpfd.blueMask]  = yrow[x];
+
+                    if (dpfd.hasAlpha) {
+                        dptr[dpfd.alphaMask] = 255;
+                    }
+
+                    dptr += dpfd.bytesPerPixel;
+                }
+                continue;
+            }
+
+            int cy = y >> spfd.chromaShiftY;
+            const u8* cbrow = _planes[1] + cy * _planePitch[1];
+            const u8* crrow = _planes[2] + cy * _planePitch[2];
+
+            for (int x = 0; x < _width; x++) {
+                int cx = x >> spfd.chromaShiftX;
+                int lum = yrow[x];
+                int cb = cbrow[cx];
+                int cr = crrow[cx];
+
+                dptr[dpfd.redMask]   = clamp_u8(lum + cr_r[cr]);
+                dptr[dpfd.greenMask] = clamp_u8(lum + ((cb_g[cb] + cr_g[cr]) >> 16));
+                dptr[dpfd.blueMask]  = clamp_u8(lum + cb_b[cb]);
+
+                if (dpfd.hasAlpha) {
+                    dptr[dpfd.alphaMask] = 255;
+                }
+
+                dptr += dpfd.bytesPerPixel;
+            }
+        }
+
+        return result;
+    }
+
+}
@@ -27,9 +27,14 @@
 
 #include "../azura.hpp"
 
+#include "cpu.hpp"
+#include "kernels.hpp"
+#include "thread.hpp"
 #include "FileImpl.hpp"
 #include "MemoryFileImpl.hpp"
 #include "ImageImpl.hpp"
+#include "PaletteBuilderImpl.hpp"
+#include "quantize.hpp"
 
 #include "bmp/bmp.hpp"
 #include "png/png.hpp"
@@ -70,6 +75,50 @@ namespace azura {
         return AZURA_VERSION_NUMBER;
     }
 
+    //--------------------------------------------------------------
+    int GetCpuFeatures()
+    {
+        return QueryCpuFeatures();
+    }
+
+    //--------------------------------------------------------------
+    int GetKernelCount()
+    {
+        return Kernel::Count;
+    }
+
+    //--------------------------------------------------------------
+    std::string GetKernelName(int index)
+    {
+        if (index < 0 || index >= Kernel::Count) {
+            return "";
+        }
+
+        return GetKernelInfo((Kernel::Enum)index).name;
+    }
+
+    //--------------------------------------------------------------
+    std::string GetKernelPath(int index)
+    {
+        if (index < 0 || index >= Kernel::Count) {
+            return "";
+        }
+
+        return GetKernelInfo((Kernel::Enum)index).path;
+    }
+
+    //--------------------------------------------------------------
+    void SetThreadCount(int count)
+    {
+        SetWorkerCount(count);
+    }
+
+    //--------------------------------------------------------------
+    int GetThreadCount()
+    {
+        return GetWorkerCount();
+    }
+
     //--------------------------------------------------------------
     FileFormat::Enum GetFileFormat(const std::string& filename)
     {
@@ -132,7 +181,107 @@ namespace azura {
     }
 
     //--------------------------------------------------------------
-    Image::Ptr ReadImage(File* file, FileFormat::Enum ff, PixelFormat::Enum pf)
+    Image::Ptr CreateAlphaPaletteImage(int width, int height, PixelFormat::Enum pf, const u8* pixels, const RGBA palette[256])
+    {
+        if (width * height <= 0 || pf < 0) {
+            return 0;
+        }
+
+        Image::Ptr image = new ImageImpl(width, height, pf);
+
+        if (pixels) {
+            image->setPixels(pixels);
+        }
+
+        if (palette) {
+            image->setAlphaPalette(palette);
+        }
+
+        return image;
+    }
+
+    //--------------------------------------------------------------
+    Image::Ptr QuantizeImage(Image* image, PixelFormat::Enum pf, const QuantizeOptions& options, QuantizeStats* stats)
+    {
+        if (!image || pf < 0 || pf >= PixelFormat::Count) {
+            return 0;
+        }
+
+        if (Image::GetPixelFormatDescriptor(pf).isDirectColor) {
+            // quantization only produces indexed images
+            return 0;
+        }
+
+        // color quantization requires source pixels in RGB format
+        Image::Ptr rgb_image = image->convert(PixelFormat::RGB);
+        if (!rgb_image) {
+            return 0;
+        }
+
+        int width  = image->getWidth();
+        int height = image->getHeight();
+
+        Image::Ptr plt_image = new ImageImpl(width, height, PixelFormat::RGB_P8);
+
+        if (Quantize((RGB*)rgb_image->getPixels(), width, height, plt_image->getPixels(), plt_image->getPalette(), options, stats) == 0) {
+            return 0;
+        }
+
+        if (pf != PixelFormat::RGB_P8) {
+            // the quantized palette is fully opaque
+            plt_image = plt_image->convert(pf);
+        }
+
+        return plt_image;
+    }
+
+    //--------------------------------------------------------------
+    PaletteBuilder::Ptr CreatePaletteBuilder(const QuantizeOptions& options)
+    {
+        Quantizer::Ptr quantizer = CreateQuantizer(options);
+        if (!quantizer) {
+            return 0;
+        }
+
+        return new PaletteBuilderImpl(quantizer.get(), options);
+    }
+
+    //--------------------------------------------------------------
+    Image::Ptr MapImageToPalette(Image* image, const RGB* palette, int colorCount, PixelFormat::Enum pf)
+    {
+        if (!image || !palette || colorCount <= 0 || colorCount > 256 || pf < 0 || pf >= PixelFormat::Count) {
+            return 0;
+        }
+
+        if (Image::GetPixelFormatDescriptor(pf).isDirectColor) {
+            // mapping only produces indexed images
+            return 0;
+        }
+
+        Image::Ptr rgb_image = image->convert(PixelFormat::RGB);
+        if (!rgb_image) {
+            return 0;
+        }
+
+        int width  = image->getWidth();
+        int height = image->getHeight();
+
+        Image::Ptr plt_image = new ImageImpl(width, height, PixelFormat::RGB_P8);
+
+        // unused palette entries stay black
+        std::memcpy(plt_image->getPalette(), palette, colorCount * sizeof(RGB));
+
+        MapToPalette((RGB*)rgb_image->getPixels(), width * height, plt_image->getPixels(), palette, colorCount);
+
+        if (pf != PixelFormat::RGB_P8) {
+            plt_image = plt_image->convert(pf);
+        }
+
+        return plt_image;
+    }
+
+    //--------------------------------------------------------------
+    Image::Ptr ReadImage(File* file, FileFormat::Enum ff, PixelFormat::Enum pf, const ReadOptions& options)
     {
         if (!file || (pf != PixelFormat::DontCare && pf < 0)) {
             return 0;
@@ -149,7 +298,7 @@ namespace azura {
             }
             case FileFormat::PNG:
             {
-                image = ReadPNG(file);
+                image = ReadPNG(file, options.png);
                 break;
             }
             case FileFormat::JPEG:
@@ -170,7 +319,7 @@ namespace azura {
                 file->seek(initial_pos);
 
                 // try reading as PNG
-                image = ReadPNG(file);
+                image = ReadPNG(file, options.png);
                 if (image) {
                     break;
                 }
@@ -194,7 +343,7 @@ namespace azura {
     }
 
     //--------------------------------------------------------------
-    Image::Ptr ReadImage(const std::string& filename, FileFormat::Enum ff, PixelFormat::Enum pf)
+    Image::Ptr ReadImage(const std::string& filename, FileFormat::Enum ff, PixelFormat::Enum pf, const ReadOptions& options)
     {
         File::Ptr file = OpenFile(filename);
 
@@ -209,11 +358,61 @@ namespace azura {
             }
         }
 
-        return ReadImage(file, ff, pf);
+        return ReadImage(file, ff, pf, options);
+    }
+
+    //--------------------------------------------------------------
+    PlanarImage::Ptr ReadPlanarImage(File* file, FileFormat::Enum ff)
+    {
+        if (!file) {
+            return 0;
+        }
+
+        switch (ff)
+        {
+            case FileFormat::JPEG:
+            case FileFormat::AutoDetect:
+            {
+                // JPEG is the only format that stores planar images
+                return ReadPlanarJPEG(file);
+            }
+            default:
+                return 0;
+        }
+    }
+
+    //--------------------------------------------------------------
+    PlanarImage::Ptr ReadPlanarImage(const std::string& filename, FileFormat::Enum ff)
+    {
+        File::Ptr file = OpenFile(filename);
+
+        if (!file) {
+            return 0;
+        }
+
+        if (ff == FileFormat::AutoDetect) {
+            ff = GetFileFormat(filename);
+            if (ff == FileFormat::Unknown) {
+                ff = FileFormat::AutoDetect;
+            }
+        }
+
+        return ReadPlanarImage(file, ff);
+    }
+
+    //--------------------------------------------------------------
+    PushDecoder::Ptr CreatePushDecoder(FileFormat::Enum ff, PushDecoder::Listener* listener)
+    {
+        switch (ff) {
+            case FileFormat::PNG:
+                return CreatePngPushDecoder(listener);
+            default:
+                return 0;
+        }
     }
 
     //--------------------------------------------------------------
-    bool WriteImage(Image* image, File* file, FileFormat::Enum ff)
+    bool WriteImage(Image* image, File* file, FileFormat::Enum ff, const WriteOptions& options)
     {
         if (!image || !file) {
             return false;
@@ -221,9 +420,9 @@ namespace azura {
 
         switch (ff) {
             case FileFormat::BMP:
-                return WriteBMP(image, file);
+                return WriteBMP(image, file, options.bmp);
             case FileFormat::PNG:
-                return WritePNG(image, file);
+                return WritePNG(image, file, options.png);
             case FileFormat::JPEG:
                 return WriteJPEG(image, file);
             default:
@@ -232,7 +431,7 @@ namespace azura {
     }
 
     //--------------------------------------------------------------
-    bool WriteImage(Image* image, const std::string& filename, FileFormat::Enum ff)
+    bool WriteImage(Image* image, const std::string& filename, FileFormat::Enum ff, const WriteOptions& options)
     {
         if (!image || filename.empty()) {
             return false;
@@ -251,7 +450,7 @@ namespace azura {
             }
         }
 
-        return WriteImage(image, file, ff);
+        return WriteImage(image, file, ff, options);
     }
 
 }
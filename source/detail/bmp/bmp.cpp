@@ -22,17 +22,26 @@
     THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cstdlib>
 #include <cmath>
 #include <cstring>
 
 #include "../ArrayAutoPtr.hpp"
+#include "../ByteArray.hpp"
 #include "../DataStream.hpp"
 #include "../ImageImpl.hpp"
+#include "../kernels.hpp"
+#include "../thread.hpp"
 #include "bmp.hpp"
 
 
+#define WRITE_BUFFER_SIZE (1 << 20) /* bytes of pixel data per write */
+#define MIN_BAND_SIZE     65536     /* pixels converted by one thread at least */
+
+
 namespace azura {
 
     //-----------------------------------------------------------------
@@ -70,6 +79,303 @@ namespace azura {
         u32 biClrImportant;
     };
 
+    namespace {
+
+        //-----------------------------------------------------------------
+        struct row_format {
+            int bits_per_pixel;
+            PixelFormat::Enum pixel_format;
+            bool is_plain; // 32-bit pixels laid out as BGRA
+            BitfieldsLayout layout;
+        };
+
+        //-----------------------------------------------------------------
+        // palettized rows become palette indices, all others BGR or BGRA
+        // pixels; the scratch row holds width BGRA pixels
+        void convert_row(const row_format& format, const u8* src, u8* dst, u8* scratch, int width)
+        {
+            switch (format.bits_per_pixel)
+            {
+            case 1: {
+                for (int ix = width / 8; ix > 0; --ix) {
+                    u32 bits = *src;
+
+                    dst[0] = (bits >> 7);
+                    dst[1] = (bits >> 6) & 1;
+                    dst[2] = (bits >> 5) & 1;
+                    dst[3] = (bits >> 4) & 1;
+                    dst[4] = (bits >> 3) & 1;
+                    dst[5] = (bits >> 2) & 1;
+                    dst[6] = (bits >> 1) & 1;
+                    dst[7] = (bits     ) & 1;
+
+                    src += 1;
+                    dst += 8;
+                }
+
+                // make sure we don't lose any pixels
+                if (width % 8 != 0) {
+                    u32 bits = *src;
+
+                    for (int i = 0; i < width % 8; i++) {
+                        dst[i] = (bits >> (7 - i)) & 1;
+                    }
+                }
+            }
+            break;
+
+            case 4: {
+                for (int ix = width / 2; ix > 0; --ix) {
+                    dst[0] = (*src >> 4);
+                    dst[1] = (*src & 0x0F);
+
+                    src += 1;
+                    dst += 2;
+                }
+
+                // make sure we don't lose any pixels
+                if (width % 2 != 0) {
+                    dst[0] = (*src >> 4);
+                }
+            }
+            break;
+
+            case 8: {
+                std::memcpy(dst, src, width);
+            }
+            break;
+
+            case 24: {
+                std::memcpy(dst, src, width * 3);
+            }
+            break;
+
+            case 16:
+            case 32: {
+                if (format.is_plain) {
+                    // the channels are whole bytes already
+                    const PixelFormatDescriptor& spfd = Image::GetPixelFormatDescriptor(PixelFormat::BGRA);
+                    const PixelFormatDescriptor& dpfd = Image::GetPixelFormatDescriptor(format.pixel_format);
+                    GetKernels().swizzlePixels(src, spfd, dst, dpfd, width);
+                } else if (format.pixel_format == PixelFormat::BGRA) {
+                    GetKernels().unpackBitfields(src, format.bits_per_pixel / 8, width, format.layout, dst);
+                } else {
+                    // unpack to BGRA first, then drop the alpha channel
+                    const PixelFormatDescriptor& spfd = Image::GetPixelFormatDescriptor(PixelFormat::BGRA);
+                    const PixelFormatDescriptor& dpfd = Image::GetPixelFormatDescriptor(PixelFormat::BGR);
+                    GetKernels().unpackBitfields(src, format.bits_per_pixel / 8, width, format.layout, scratch);
+                    GetKernels().swizzlePixels(scratch, spfd, dst, dpfd, width);
+                }
+            }
+            break;
+
+            }
+        }
+
+        //-----------------------------------------------------------------
+        // each part converts a band of rows, using its own scratch row
+        class ConvertRowsTask : public ParallelTask {
+        public:
+            ConvertRowsTask(const row_format& format, const u8* data, int row_size, u8* pixels, int pitch, int width, int height, bool flipped, u8* scratch, int parts)
+                : _format(format)
+                , _data(data)
+                , _rowSize(row_size)
+                , _pixels(pixels)
+                , _pitch(pitch)
+                , _width(width)
+                , _height(height)
+                , _flipped(flipped)
+                , _scratch(scratch)
+                , _parts(parts)
+            {
+            }
+
+            void run(int part) {
+                int begin = (int)((i64)_height * part / _parts);
+                int end   = (int)((i64)_height * (part + 1) / _parts);
+
+                u8* scratch = _scratch + part * _width * 4;
+
+                for (int y = begin; y < end; y++) {
+                    int iy = (_flipped ? _height - 1 - y : y);
+                    convert_row(_format, _data + y * _rowSize, _pixels + iy * _pitch, scratch, _width);
+                }
+            }
+
+        private:
+            const row_format& _format;
+            const u8* _data;
+            int _rowSize;
+            u8* _pixels;
+            int _pitch;
+            int _width;
+            int _height;
+            bool _flipped;
+            u8* _scratch;
+            int _parts;
+        };
+
+        //-----------------------------------------------------------------
+        // decodes RLE8 or RLE4 data into one palette index per pixel;
+        // the rows are stored bottom-up and skipped pixels stay 0
+        void decode_rle(const u8* src, int size, int bits_per_pixel, u8* pixels, int width, int height)
+        {
+            const u8* end = src + size;
+
+            int x = 0;
+            int y = height - 1;
+
+            while (y >= 0 && end - src >= 2) {
+                int count = src[0];
+                int value = src[1];
+                src += 2;
+
+                if (count > 0) {
+                    // encoded mode, a run of count pixels alternating
+                    // between the two nibbles in case of RLE4
+                    u8 a = (u8)(bits_per_pixel == 8 ? value : value >> 4);
+                    u8 b = (u8)(bits_per_pixel == 8 ? value : value & 0x0F);
+
+                    u8* row = pixels + y * width;
+                    int n = std::min(count, width - x);
+
+                    for (int i = 0; i < n; i++) {
+                        row[x + i] = ((i & 1) ? b : a);
+                    }
+
+                    x = std::min(x + count, width);
+                } else if (value == 0) {
+                    // end of line
+                    x = 0;
+                    y--;
+                } else if (value == 1) {
+                    // end of bitmap
+                    break;
+                } else if (value == 2) {
+                    // delta, moves to the right and up
+                    if (end - src < 2) {
+                        break;
+                    }
+
+                    x = std::min(x + src[0], width);
+                    y -= src[1];
+                    src += 2;
+                } else {
+                    // absolute mode, the pixels follow as they are,
+                    // padded to a 16-bit boundary
+                    int bytes = (bits_per_pixel == 8 ? value : (value + 1) / 2);
+                    if (end - src < bytes) {
+                        break;
+                    }
+
+                    u8* row = pixels + y * width;
+                    int n = std::min(value, width - x);
+
+                    if (bits_per_pixel == 8) {
+                        for (int i = 0; i < n; i++) {
+                            row[x + i] = src[i];
+                        }
+                    } else {
+                        for (int i = 0; i < n; i++) {
+                            row[x + i] = ((i & 1) ? (src[i / 2] & 0x0F) : (src[i / 2] >> 4));
+                        }
+                    }
+
+                    x = std::min(x + value, width);
+
+                    src += bytes;
+                    if ((bytes & 1) && src < end) {
+                        src++;
+                    }
+                }
+            }
+        }
+
+    }
+
+    namespace {
+
+        //-----------------------------------------------------------------
+        inline void put_bytes(u8*& dst, const char* bytes, int count)
+        {
+            std::memcpy(dst, bytes, count);
+            dst += count;
+        }
+
+        //-----------------------------------------------------------------
+        inline void put_uint16(u8*& dst, u16 n)
+        {
+            dst[0] = (u8)(n);
+            dst[1] = (u8)(n >> 8);
+            dst += 2;
+        }
+
+        //-----------------------------------------------------------------
+        inline void put_uint32(u8*& dst, u32 n)
+        {
+            dst[0] = (u8)(n);
+            dst[1] = (u8)(n >> 8);
+            dst[2] = (u8)(n >> 16);
+            dst[3] = (u8)(n >> 24);
+            dst += 4;
+        }
+
+        //-----------------------------------------------------------------
+        // appends one RLE8 encoded row and returns the number of bytes
+        // written, which is never more than width * 2
+        int encode_rle8_row(const u8* row, int width, u8* dst)
+        {
+            u8* start = dst;
+            int x = 0;
+
+            while (x < width) {
+                int run = 1;
+                while (x + run < width && run < 255 && row[x + run] == row[x]) {
+                    run++;
+                }
+
+                if (run >= 3) {
+                    *dst++ = (u8)run;
+                    *dst++ = row[x];
+                    x += run;
+                    continue;
+                }
+
+                // gather pixels up to the next run of three or more
+                int n = 0;
+                while (x + n < width && n < 255) {
+                    if (x + n + 2 < width && row[x + n] == row[x + n + 1] && row[x + n] == row[x + n + 2]) {
+                        break;
+                    }
+                    n++;
+                }
+
+                if (n >= 3) {
+                    // absolute mode, padded to a 16-bit boundary
+                    *dst++ = 0;
+                    *dst++ = (u8)n;
+                    std::memcpy(dst, row + x, n);
+                    dst += n;
+                    if (n & 1) {
+                        *dst++ = 0;
+                    }
+                    x += n;
+                } else {
+                    // absolute mode needs at least three pixels
+                    for (int end = x + n; x < end; ) {
+                        int count = ((x + 1 < end && row[x + 1] == row[x]) ? 2 : 1);
+                        *dst++ = (u8)count;
+                        *dst++ = row[x];
+                        x += count;
+                    }
+                }
+            }
+
+            return (int)(dst - start);
+        }
+
+    }
+
     //-----------------------------------------------------------------
     Image::Ptr ReadBMP(File* file)
     {
@@ -120,8 +426,13 @@ namespace azura {
             return 0;
         }
 
-        if (ih.biSize != 40) {
-            // we don't support other versions of the bitmap info header for now
+        if (ih.biSize != 40  &&
+            ih.biSize != 52  &&
+            ih.biSize != 56  &&
+            ih.biSize != 108 &&
+            ih.biSize != 124)
+        {
+            // unknown version of the bitmap info header
             return 0;
         }
 
@@ -141,12 +452,75 @@ namespace azura {
             return 0;
         }
 
-        if (ih.biCompression != BI_RGB) {
+        if (ih.biCompression != BI_RGB       &&
+            ih.biCompression != BI_RLE8      &&
+            ih.biCompression != BI_RLE4      &&
+            ih.biCompression != BI_BITFIELDS &&
+            ih.biCompression != BI_ALPHABITFIELDS)
+        {
             // we don't support anything else for now
             return 0;
         }
 
-        if (ih.biClrUsed > 255) {
+        if ((ih.biCompression == BI_BITFIELDS || ih.biCompression == BI_ALPHABITFIELDS) &&
+            ih.biBitCount != 16 && ih.biBitCount != 32)
+        {
+            // channel masks only apply to 16 and 32-bit pixels
+            return 0;
+        }
+
+        bool is_rle = (ih.biCompression == BI_RLE8 || ih.biCompression == BI_RLE4);
+
+        if ((ih.biCompression == BI_RLE8 && ih.biBitCount != 8) ||
+            (ih.biCompression == BI_RLE4 && ih.biBitCount != 4) ||
+            (is_rle && ih.biHeight < 0))
+        {
+            // run-length encoded bitmaps are always stored bottom-up
+            return 0;
+        }
+
+        // read the red, green, blue and alpha masks, which are part of the
+        // newer headers or follow the 40 byte header for bitfields
+        u32 masks[4] = { 0, 0, 0, 0 };
+        int masks_count = 0;
+
+        if (ih.biSize > 40) {
+            masks_count = (ih.biSize == 52 ? 3 : 4);
+        } else if (ih.biCompression == BI_BITFIELDS) {
+            masks_count = 3;
+        } else if (ih.biCompression == BI_ALPHABITFIELDS) {
+            masks_count = 4;
+        }
+
+        for (int i = 0; i < masks_count; i++) {
+            stream.readUint32(masks[i]);
+        }
+
+        if (stream.getFile()->eof()) {
+            return 0;
+        }
+
+        // skip the color space information of V4 and V5 headers
+        if (ih.biSize > 56 && !stream.getFile()->seek(stream_start_pos + 14 + ih.biSize)) {
+            return 0;
+        }
+
+        if (ih.biCompression == BI_RGB) {
+            // uncompressed pixels have fixed color channels, only an
+            // alpha mask given by a newer header is honored
+            if (ih.biBitCount == 16) {
+                masks[0] = 0x7C00;
+                masks[1] = 0x03E0;
+                masks[2] = 0x001F;
+                masks[3] = 0;
+            } else {
+                masks[0] = 0x00FF0000;
+                masks[1] = 0x0000FF00;
+                masks[2] = 0x000000FF;
+            }
+        }
+
+        if (ih.biClrUsed > 256) {
             // invalid size of color table
             return 0;
         }
@@ -159,17 +533,25 @@ namespace azura {
         bool has_color_table  = (ih.biBitCount <= 8);
         int  color_table_size = (has_color_table ? ((ih.biClrUsed > 0) ? ih.biClrUsed : (1 << ih.biBitCount)) : 0);
 
-        // read color table if present
-        ArrayAutoPtr<u8> color_table_buf;
+        // read color table if present, palettized images stay indexed
+        RGB palette[256];
         if (has_color_table) {
-            // allocate enough memory to hold 256 color entries
-            color_table_buf = new u8[256 * 4];
+            u8 color_table_buf[256 * 4];
 
             // read color table entries
-            stream.readBytes(color_table_buf.get(), color_table_size * 4);
+            stream.readBytes(color_table_buf, color_table_size * 4);
             if (stream.getFile()->eof()) {
                 return 0;
             }
+
+            // indices beyond the color table map to black
+            std::memset(palette, 0, sizeof(palette));
+
+            for (int i = 0; i < color_table_size; i++) {
+                palette[i].red   = color_table_buf[i * 4 + 2];
+                palette[i].green = color_table_buf[i * 4 + 1];
+                palette[i].blue  = color_table_buf[i * 4 + 0];
+            }
         }
 
         // there could be a filler gap just before the image data,
@@ -179,177 +561,117 @@ namespace azura {
         }
 
         // read image data
-        int pitch  = image_width * 3;
-        int iy     = 0;
-        int iy_inc = 1;
-        int iy_end = image_height;
-
-        if (is_image_flipped) {
-            iy     = image_height - 1;
-            iy_inc = -1;
-            iy_end = -1;
-        }
-
-        int row_size = (int)(std::floor(((double)bits_per_pixel * (double)image_width + 31.0) / 32.0) * 4);
-        ArrayAutoPtr<u8> row_buf = new u8[row_size];
-        RefPtr<ImageImpl> image = new ImageImpl(image_width, image_height, PixelFormat::BGR);
+        row_format format;
+        format.bits_per_pixel = bits_per_pixel;
+        format.pixel_format   = PixelFormat::BGR;
+        format.is_plain       = false;
 
-        while (iy != iy_end) {
-            // read one row of image data
-            stream.readBytes(row_buf.get(), row_size);
-            if (stream.getFile()->eof()) {
-                return 0;
+        if (has_color_table) {
+            format.pixel_format = PixelFormat::RGB_P8;
+        } else if (bits_per_pixel == 16 || bits_per_pixel == 32) {
+            if (masks[3] != 0) {
+                format.pixel_format = PixelFormat::BGRA;
             }
 
-            u8* tbl = color_table_buf.get();
-            u8* src = row_buf.get();
-            u8* dst = (u8*)image->getPixels() + iy * pitch;
+            format.is_plain = (bits_per_pixel == 32 &&
+                               masks[0] == 0x00FF0000 &&
+                               masks[1] == 0x0000FF00 &&
+                               masks[2] == 0x000000FF &&
+                               (masks[3] == 0 || masks[3] == 0xFF000000));
 
-            // convert pixels
-            switch (bits_per_pixel)
-            {
-            case 1: {
-                for (int ix = image_width / 8; ix > 0; --ix) {
-                    u32 indices = *src;
-                    u32 rshift  = 7;
-                    u32 mask    = 0x80; // 1000 0000
+            SetupBitfieldsLayout(format.layout, masks[0], masks[1], masks[2], masks[3]);
+        }
 
-                    for (int i = 8; i > 0; --i) {
-                        u32 offset = ((indices & mask) >> rshift) * 4;
+        PixelFormat::Enum pixel_format = format.pixel_format;
 
-                        dst[0] = tbl[offset + 0];
-                        dst[1] = tbl[offset + 1];
-                        dst[2] = tbl[offset + 2];
+        int pitch    = image_width * Image::GetPixelFormatDescriptor(pixel_format).bytesPerPixel;
+        int row_size = (int)(std::floor(((double)bits_per_pixel * (double)image_width + 31.0) / 32.0) * 4);
 
-                        rshift--;
-                        mask = mask >> 1;
-                        dst += 3;
-                    }
+        if ((double)row_size * (double)image_height > (double)INT_MAX) {
+            // the pixel data wouldn't fit into memory anyway
+            return 0;
+        }
 
-                    src += 1;
-                }
+        int data_size = row_size * image_height;
 
-                // make sure we don't lose any pixels
-                if (image_width % 8 != 0) {
-                    u32 indices = *src;
-                    u32 rshift  = 7;
-                    u32 mask    = 0x80; // 1000 0000
+        RefPtr<ImageImpl> image = new ImageImpl(image_width, image_height, pixel_format);
 
-                    for (int i = image_width % 8; i > 0; --i) {
-                        u32 offset = ((indices & mask) >> rshift) * 4;
+        if (has_color_table) {
+            image->setPalette(palette);
+        }
 
-                        dst[0] = tbl[offset + 0];
-                        dst[1] = tbl[offset + 1];
-                        dst[2] = tbl[offset + 2];
+        if (is_rle) {
+            // the compressed data ends at the end of the file, unless
+            // the header tells otherwise
+            int rle_pos = stream.getFile()->tell();
 
-                        rshift--;
-                        mask = mask >> 1;
-                        dst += 3;
-                    }
-                }
+            if (!stream.getFile()->seek(0, File::End)) {
+                return 0;
             }
-            break;
-
-            case 4: {
-                for (int ix = image_width / 2; ix > 0; --ix) {
-                    u32 offset = (*src >> 4) * 4;
 
-                    dst[0] = tbl[offset + 0];
-                    dst[1] = tbl[offset + 1];
-                    dst[2] = tbl[offset + 2];
-
-                    offset = (*src & 0x0F) * 4;
-
-                    dst[3] = tbl[offset + 0];
-                    dst[4] = tbl[offset + 1];
-                    dst[5] = tbl[offset + 2];
-
-                    src += 1;
-                    dst += 6;
-                }
-
-                // make sure we don't lose any pixels
-                if (image_width % 2 != 0) {
-                    u32 offset = (*src >> 4) * 4;
-
-                    dst[0] = tbl[offset + 0];
-                    dst[1] = tbl[offset + 1];
-                    dst[2] = tbl[offset + 2];
-                }
+            int rle_size = stream.getFile()->tell() - rle_pos;
+            if (ih.biSizeImage > 0 && ih.biSizeImage < (u32)rle_size) {
+                rle_size = (int)ih.biSizeImage;
             }
-            break;
 
-            case 8: {
-                for (int ix = 0; ix < (int)image_width; ++ix) {
-                    u32 offset = (*src) * 4;
+            if (!stream.getFile()->seek(rle_pos)) {
+                return 0;
+            }
 
-                    dst[0] = tbl[offset + 0];
-                    dst[1] = tbl[offset + 1];
-                    dst[2] = tbl[offset + 2];
+            ArrayAutoPtr<u8> rle_buf;
+            const u8* rle_data = stream.getFile()->view(rle_size);
 
-                    src += 1;
-                    dst += 3;
+            if (!rle_data) {
+                rle_buf = new u8[rle_size > 0 ? rle_size : 1];
+                if (stream.getFile()->read(rle_buf.get(), rle_size) != rle_size) {
+                    return 0;
                 }
+                rle_data = rle_buf.get();
             }
-            break;
-
-            case 16: {
-                for (int ix = 0; ix < (int)image_width; ++ix) {
-                    u16 color = *((u16*)src);
-
-                    u8 red = (color & 0x7C00) >> 10;
-                    if (red != 0x00) {
-                        red |= 0x07;
-                    }
 
-                    u8 green = (color & 0x03E0) >> 5;
-                    if (green != 0x00) {
-                        green |= 0x07;
-                    }
-
-                    u8 blue = color & 0x001F;
-                    if (blue != 0x00) {
-                        blue |= 0x07;
-                    }
+            decode_rle(rle_data, rle_size, bits_per_pixel, image->getPixels(), image_width, image_height);
 
-                    dst[0] = blue;
-                    dst[1] = green;
-                    dst[2] = red;
+            return image;
+        }
 
-                    src += 2;
-                    dst += 3;
-                }
-            }
-            break;
+        bool is_row_native = (bits_per_pixel == 8 || bits_per_pixel == 24 || (format.is_plain && pixel_format == PixelFormat::BGRA));
 
-            case 24: {
-                std::memcpy(dst, src, pitch);
+        if (is_row_native && !is_image_flipped && row_size == pitch) {
+            // the pixel data is exactly the image buffer
+            if (stream.getFile()->read(image->getPixels(), data_size) != data_size) {
+                return 0;
             }
-            break;
+            return image;
+        }
 
-            case 32: {
-                for (int ix = 0; ix < (int)image_width; ++ix) {
-                    dst[0] = src[0];
-                    dst[1] = src[1];
-                    dst[2] = src[2];
+        // take the whole pixel data at once, borrowing it from the
+        // file if possible
+        ArrayAutoPtr<u8> data_buf;
+        const u8* data = stream.getFile()->view(data_size);
 
-                    src += 4;
-                    dst += 3;
-                }
+        if (!data) {
+            data_buf = new u8[data_size];
+            if (stream.getFile()->read(data_buf.get(), data_size) != data_size) {
+                return 0;
             }
-            break;
+            data = data_buf.get();
+        }
 
-            }
+        // the rows are independent of each other, so bands of
+        // them can be converted concurrently
+        int parts = std::min((int)((i64)image_width * image_height / MIN_BAND_SIZE), GetWorkerCount());
+        parts = std::max(1, std::min(parts, image_height));
 
-            // advance to the next row
-            iy += iy_inc;
-        }
+        ArrayAutoPtr<u8> scratch = new u8[parts * image_width * 4];
+
+        ConvertRowsTask task(format, data, row_size, image->getPixels(), pitch, image_width, image_height, is_image_flipped, scratch.get(), parts);
+        RunParallel(task, parts);
 
         return image;
     }
 
     //-----------------------------------------------------------------
-    bool WriteBMP(Image* image, File* file)
+    bool WriteBMP(Image* image, File* file, const BmpWriteOptions& options)
     {
         assert(image);
         assert(file);
@@ -358,78 +680,155 @@ namespace azura {
             return false;
         }
 
-        DataStream stream(file);
+        // write the source format as directly as possible: palettized
+        // images as 8-bit bitmaps (without their alpha), images with
+        // alpha as 32-bit BGRA and everything else as 24-bit BGR
+        const PixelFormatDescriptor& spfd = Image::GetPixelFormatDescriptor(image->getPixelFormat());
 
-        Image::Ptr src_image = image;
+        PixelFormat::Enum dst_format = PixelFormat::BGR;
+        u32 bits_per_pixel = 24;
 
-        // we currently support only BGR
-        if (src_image->getPixelFormat() != PixelFormat::BGR) {
-            src_image = src_image->convert(PixelFormat::BGR);
-            if (!src_image) {
-                return false;
-            }
+        if (!spfd.isDirectColor) {
+            dst_format = PixelFormat::RGB_P8;
+            bits_per_pixel = 8;
+        } else if (spfd.hasAlpha) {
+            dst_format = PixelFormat::BGRA;
+            bits_per_pixel = 32;
         }
 
-        u32 image_width      = src_image->getWidth();
-        u32 image_height     = src_image->getHeight();
-        u32 bits_per_pixel   = 24;
+        const PixelFormatDescriptor& dpfd = Image::GetPixelFormatDescriptor(dst_format);
+
+        bool is_indexed = (bits_per_pixel == 8);
+        bool is_rle     = (is_indexed && options.compression == BmpCompression::RLE8);
+
+        u32 image_width      = image->getWidth();
+        u32 image_height     = image->getHeight();
         u32 bitmap_row_size  = (u32)(std::floor(((double)bits_per_pixel * (double)image_width + 31.0) / 32.0) * 4);
         u32 bitmap_size      = image_height * bitmap_row_size;
         u32 file_header_size = 14;
-        u32 info_header_size = 40;
+        u32 info_header_size = (bits_per_pixel == 32 ? 108 : 40); // BGRA needs the V4 header
+        u32 color_table_size = (is_indexed ? 256 * 4 : 0);
 
-        // write file header
-        BITMAPFILEHEADER fh;
-        fh.bfType[0]    = 'B';
-        fh.bfType[1]    = 'M';
-        fh.bfSize       = file_header_size + info_header_size + bitmap_size;
-        fh.bfReserved1  = 0;
-        fh.bfReserved2  = 0;
-        fh.bfOffBits    = file_header_size + info_header_size;
-
-        stream.writeBytes(fh.bfType, 2);
-        stream.writeUint32(fh.bfSize);
-        stream.writeUint16(fh.bfReserved1);
-        stream.writeUint16(fh.bfReserved2);
-        stream.writeUint32(fh.bfOffBits);
-
-        // write info header
-        BITMAPINFOHEADER ih;
-        ih.biSize           = info_header_size;
-        ih.biWidth          = image_width;
-        ih.biHeight         = image_height;
-        ih.biPlanes         = 1;
-        ih.biBitCount       = 24;
-        ih.biCompression    = BI_RGB;
-        ih.biSizeImage      = bitmap_size;
-        ih.biXPelsPerMeter  = 0;
-        ih.biYPelsPerMeter  = 0;
-        ih.biClrUsed        = 0;
-        ih.biClrImportant   = 0;
-
-        stream.writeUint32(ih.biSize);
-        stream.writeInt32(ih.biWidth);
-        stream.writeInt32(ih.biHeight);
-        stream.writeUint16(ih.biPlanes);
-        stream.writeUint16(ih.biBitCount);
-        stream.writeUint32(ih.biCompression);
-        stream.writeUint32(ih.biSizeImage);
-        stream.writeInt32(ih.biXPelsPerMeter);
-        stream.writeInt32(ih.biYPelsPerMeter);
-        stream.writeUint32(ih.biClrUsed);
-        stream.writeUint32(ih.biClrImportant);
+        // compress the pixels up front, the headers need their size
+        ByteArray rle_data;
+
+        if (is_rle) {
+            rle_data.resize(image_width * 2 + 2);
+
+            int size = 0;
+
+            for (int iy = image_height - 1; iy >= 0; --iy) {
+                const u8* row = image->getPixels() + iy * image_width;
+
+                // make room for the worst case
+                if (rle_data.getSize() - size < (int)image_width * 2 + 2) {
+                    rle_data.resize(rle_data.getSize() * 2 + image_width * 2 + 2);
+                }
+
+                size += encode_rle8_row(row, image_width, rle_data.getBuffer() + size);
+
+                // end of line, or end of bitmap after the last row
+                rle_data[size++] = 0;
+                rle_data[size++] = (iy > 0 ? 0 : 1);
+            }
+
+            bitmap_size = size;
+        }
+
+        // put all headers together, so that they go out in a single write
+        u8 headers[14 + 108 + 256 * 4];
+        u8* h = headers;
+
+        // file header
+        put_bytes(h, "BM", 2);
+        put_uint32(h, file_header_size + info_header_size + color_table_size + bitmap_size); // bfSize
+        put_uint16(h, 0); // bfReserved1
+        put_uint16(h, 0); // bfReserved2
+        put_uint32(h, file_header_size + info_header_size + color_table_size); // bfOffBits
+
+        // info header
+        put_uint32(h, info_header_size);       // biSize
+        put_uint32(h, image_width);            // biWidth
+        put_uint32(h, image_height);           // biHeight
+        put_uint16(h, 1);                      // biPlanes
+        put_uint16(h, (u16)bits_per_pixel);    // biBitCount
+        put_uint32(h, (is_rle ? BI_RLE8 : (bits_per_pixel == 32 ? BI_BITFIELDS : BI_RGB))); // biCompression
+        put_uint32(h, bitmap_size);            // biSizeImage
+        put_uint32(h, 0);                      // biXPelsPerMeter
+        put_uint32(h, 0);                      // biYPelsPerMeter
+        put_uint32(h, 0);                      // biClrUsed
+        put_uint32(h, 0);                      // biClrImportant
+
+        if (info_header_size == 108) {
+            put_uint32(h, 0x00FF0000);         // bV4RedMask
+            put_uint32(h, 0x0000FF00);         // bV4GreenMask
+            put_uint32(h, 0x000000FF);         // bV4BlueMask
+            put_uint32(h, 0xFF000000);         // bV4AlphaMask
+            put_uint32(h, 0x73524742);         // bV4CSType, 'sRGB'
+            std::memset(h, 0, 48);             // bV4Endpoints, bV4Gamma*
+            h += 48;
+        }
+
+        // color table
+        if (is_indexed) {
+            const RGB*  palette       = image->getPalette();
+            const RGBA* alpha_palette = image->getAlphaPalette();
+
+            for (int i = 0; i < 256; i++) {
+                if (palette) {
+                    h[0] = palette[i].blue;
+                    h[1] = palette[i].green;
+                    h[2] = palette[i].red;
+                } else {
+                    h[0] = alpha_palette[i].blue;
+                    h[1] = alpha_palette[i].green;
+                    h[2] = alpha_palette[i].red;
+                }
+                h[3] = 0;
+                h += 4;
+            }
+        }
+
+        int headers_size = (int)(h - headers);
+        if (file->write(headers, headers_size) != headers_size) {
+            return false;
+        }
 
         // write image data
-        int pitch   = image_width * 3;
-        int padding = bitmap_row_size - pitch;
+        if (is_rle) {
+            return (file->write(rle_data.getBuffer(), bitmap_size) == (int)bitmap_size);
+        }
+
+        // convert bands of rows into one buffer, its row padding is
+        // zeroed once and never touched again
+        int rows_per_band = std::max(1, (int)(WRITE_BUFFER_SIZE / bitmap_row_size));
+        rows_per_band = std::min(rows_per_band, (int)image_height);
+
+        ArrayAutoPtr<u8> buffer = new u8[rows_per_band * bitmap_row_size];
+        std::memset(buffer.get(), 0, rows_per_band * bitmap_row_size);
+
+        int src_pitch = image_width * spfd.bytesPerPixel;
+        int dst_pitch = image_width * dpfd.bytesPerPixel;
+        bool is_copy  = (is_indexed || image->getPixelFormat() == dst_format);
+
+        int rows = 0;
 
         for (int iy = image_height - 1; iy >= 0; --iy) {
-            u8* row = src_image->getPixels() + iy * pitch;
+            const u8* src = image->getPixels() + iy * src_pitch;
+            u8* dst = buffer.get() + rows * bitmap_row_size;
 
-            stream.writeBytes(row, pitch);
+            if (is_copy) {
+                std::memcpy(dst, src, dst_pitch);
+            } else {
+                GetKernels().swizzlePixels(src, spfd, dst, dpfd, image_width);
+            }
 
-            if (padding > 0) {
-                stream.writeByte(0x00, padding);
+            if (++rows == rows_per_band || iy == 0) {
+                int size = rows * bitmap_row_size;
+                if (file->write(buffer.get(), size) != size) {
+                    return false;
+                }
+                rows = 0;
             }
         }
 
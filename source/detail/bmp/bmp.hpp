@@ -27,12 +27,13 @@
 
 #include "../../File.hpp"
 #include "../../Image.hpp"
+#include "../../options.hpp"
 
 
 namespace azura {
 
     Image::Ptr ReadBMP(File* file);
-    bool WriteBMP(Image* image, File* file);
+    bool WriteBMP(Image* image, File* file, const BmpWriteOptions& options = BmpWriteOptions());
 
 }
 
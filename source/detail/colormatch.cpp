@@ -0,0 +1,251 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include <cassert>
+
+#include "colormatch.hpp"
+
+#if defined(AZURA_X86)
+#    include <immintrin.h>
+#endif
+
+#define PADDING_VALUE 65536.0f /* far away from any color */
+
+
+namespace azura {
+
+    //--------------------------------------------------------------
+    void BuildNearestTable(const RGB* palette, int size, NearestTable& table)
+    {
+        assert(size > 0 && size <= 256);
+
+        table.size = size;
+        table.paddedSize = (size + 7) & ~7;
+
+        for (int i = 0; i < size; i++) {
+            table.red[i]   = palette[i].red;
+            table.green[i] = palette[i].green;
+            table.blue[i]  = palette[i].blue;
+        }
+
+        for (int i = size; i < table.paddedSize; i++) {
+            table.red[i]   = PADDING_VALUE;
+            table.green[i] = PADDING_VALUE;
+            table.blue[i]  = PADDING_VALUE;
+        }
+    }
+
+    //--------------------------------------------------------------
+    void FindNearestScalar(const RGB* colors, int count, const NearestTable& table, u8* indices)
+    {
+        for (int i = 0; i < count; i++) {
+            int r = colors[i].red;
+            int g = colors[i].green;
+            int b = colors[i].blue;
+
+            int best_dist = 0x7FFFFFFF;
+            int best_index = 0;
+
+            for (int j = 0; j < table.size; j++) {
+                int dr = (int)table.red[j]   - r;
+                int dg = (int)table.green[j] - g;
+                int db = (int)table.blue[j]  - b;
+                int dist = dr * dr + dg * dg + db * db;
+
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best_index = j;
+                }
+            }
+
+            indices[i] = (u8)best_index;
+        }
+    }
+
+    //--------------------------------------------------------------
+    u8 RefineNearestScalar(const RGB& color, const u8* candidates, int count, const NearestTable& table)
+    {
+        int best_dist = 0x7FFFFFFF;
+        int best_index = 0;
+
+        for (int i = 0; i < count; i++) {
+            int j = candidates[i];
+
+            int dr = (int)table.red[j]   - color.red;
+            int dg = (int)table.green[j] - color.green;
+            int db = (int)table.blue[j]  - color.blue;
+            int dist = dr * dr + dg * dg + db * db;
+
+            if (dist < best_dist) {
+                best_dist = dist;
+                best_index = j;
+            }
+        }
+
+        return (u8)best_index;
+    }
+
+#if defined(AZURA_X86)
+
+    namespace {
+
+        // picks the lane with the smallest distance, ties go to the lowest
+        // index; all distances are exact integers, so this matches the
+        // scalar kernel bit for bit
+        inline u8 reduce_lanes(const float* dist, const int* index, int lanes)
+        {
+            float best_dist = dist[0];
+            int best_index = index[0];
+
+            for (int i = 1; i < lanes; i++) {
+                if (dist[i] < best_dist || (dist[i] == best_dist && index[i] < best_index)) {
+                    best_dist = dist[i];
+                    best_index = index[i];
+                }
+            }
+
+            return (u8)best_index;
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("sse2")
+    void FindNearestSSE2(const RGB* colors, int count, const NearestTable& table, u8* indices)
+    {
+        const __m128i step = _mm_set1_epi32(4);
+
+        for (int i = 0; i < count; i++) {
+            __m128 r = _mm_set1_ps(colors[i].red);
+            __m128 g = _mm_set1_ps(colors[i].green);
+            __m128 b = _mm_set1_ps(colors[i].blue);
+
+            __m128 best_dist = _mm_set1_ps(3.0e38f);
+            __m128i best_index = _mm_setzero_si128();
+            __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+
+            for (int j = 0; j < table.paddedSize; j += 4) {
+                __m128 dr = _mm_sub_ps(_mm_loadu_ps(table.red   + j), r);
+                __m128 dg = _mm_sub_ps(_mm_loadu_ps(table.green + j), g);
+                __m128 db = _mm_sub_ps(_mm_loadu_ps(table.blue  + j), b);
+
+                __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                __m128i closer = _mm_castps_si128(_mm_cmplt_ps(dist, best_dist));
+
+                best_dist = _mm_min_ps(dist, best_dist);
+                best_index = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, best_index));
+                index = _mm_add_epi32(index, step);
+            }
+
+            float dist[4];
+            int idx[4];
+            _mm_storeu_ps(dist, best_dist);
+            _mm_storeu_si128((__m128i*)idx, best_index);
+
+            indices[i] = reduce_lanes(dist, idx, 4);
+        }
+    }
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("avx2")
+    void FindNearestAVX2(const RGB* colors, int count, const NearestTable& table, u8* indices)
+    {
+        const __m256i step = _mm256_set1_epi32(8);
+
+        for (int i = 0; i < count; i++) {
+            __m256 r = _mm256_set1_ps(colors[i].red);
+            __m256 g = _mm256_set1_ps(colors[i].green);
+            __m256 b = _mm256_set1_ps(colors[i].blue);
+
+            __m256 best_dist = _mm256_set1_ps(3.0e38f);
+            __m256i best_index = _mm256_setzero_si256();
+            __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+            for (int j = 0; j < table.paddedSize; j += 8) {
+                __m256 dr = _mm256_sub_ps(_mm256_loadu_ps(table.red   + j), r);
+                __m256 dg = _mm256_sub_ps(_mm256_loadu_ps(table.green + j), g);
+                __m256 db = _mm256_sub_ps(_mm256_loadu_ps(table.blue  + j), b);
+
+                __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)), _mm256_mul_ps(db, db));
+                __m256 closer = _mm256_cmp_ps(dist, best_dist, _CMP_LT_OQ);
+
+                best_dist = _mm256_min_ps(dist, best_dist);
+                best_index = _mm256_blendv_epi8(best_index, index, _mm256_castps_si256(closer));
+                index = _mm256_add_epi32(index, step);
+            }
+
+            float dist[8];
+            int idx[8];
+            _mm256_storeu_ps(dist, best_dist);
+            _mm256_storeu_si256((__m256i*)idx, best_index);
+
+            indices[i] = reduce_lanes(dist, idx, 8);
+        }
+    }
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("avx2")
+    u8 RefineNearestAVX2(const RGB& color, const u8* candidates, int count, const NearestTable& table)
+    {
+        if (count < 8) {
+            // gathering doesn't pay off for a handful of candidates
+            return RefineNearestScalar(color, candidates, count, table);
+        }
+
+        __m256 r = _mm256_set1_ps(color.red);
+        __m256 g = _mm256_set1_ps(color.green);
+        __m256 b = _mm256_set1_ps(color.blue);
+
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        __m256 best_dist = _mm256_set1_ps(3.0e38f);
+        __m256i best_index = _mm256_setzero_si256();
+
+        for (int j = 0; j < count; j += 8) {
+            __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(candidates + j)));
+
+            __m256 dr = _mm256_sub_ps(_mm256_i32gather_ps(table.red,   index, 4), r);
+            __m256 dg = _mm256_sub_ps(_mm256_i32gather_ps(table.green, index, 4), g);
+            __m256 db = _mm256_sub_ps(_mm256_i32gather_ps(table.blue,  index, 4), b);
+
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)), _mm256_mul_ps(db, db));
+
+            // lanes past the last candidate don't take part
+            __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - j), lanes);
+            __m256 closer = _mm256_and_ps(_mm256_cmp_ps(dist, best_dist, _CMP_LT_OQ), _mm256_castsi256_ps(valid));
+
+            best_dist = _mm256_blendv_ps(best_dist, dist, closer);
+            best_index = _mm256_blendv_epi8(best_index, index, _mm256_castps_si256(closer));
+        }
+
+        float dist[8];
+        int idx[8];
+        _mm256_storeu_ps(dist, best_dist);
+        _mm256_storeu_si256((__m256i*)idx, best_index);
+
+        return reduce_lanes(dist, idx, 8);
+    }
+
+#endif
+
+}
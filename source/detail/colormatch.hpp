@@ -0,0 +1,123 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_COLORMATCH_HPP_INCLUDED
+#define AZURA_COLORMATCH_HPP_INCLUDED
+
+#include <cstring>
+
+#include "../types.hpp"
+#include "../color.hpp"
+#include "cpu.hpp"
+
+
+namespace azura {
+
+    // a palette laid out for the nearest color kernels, one array per
+    // channel; the entries past size are padding that never matches
+    struct NearestTable {
+        float red[256];
+        float green[256];
+        float blue[256];
+        int size;
+        int paddedSize; /* size rounded up to a multiple of 8 */
+    };
+
+    void BuildNearestTable(const RGB* palette, int size, NearestTable& table);
+
+    // remembers the nearest palette entries of recently seen colors, keyed
+    // by their histogram cell or bucket; every mapping thread keeps its own,
+    // so that the tables shared between them are only ever read
+    class NearestCache {
+    public:
+        static const int Size = 1024;
+
+        NearestCache();
+
+        bool find(u32 key, u8& index) const;
+        void set(u32 key, u8 index);
+
+    private:
+        static int GetSlot(u32 key);
+
+    private:
+        u32 _keys[Size];
+        u8 _indices[Size];
+    };
+
+    // the nearest color kernels find the palette entry with the smallest
+    // squared euclidean distance to each color, ties go to the lowest index
+    void FindNearestScalar(const RGB* colors, int count, const NearestTable& table, u8* indices);
+
+    // the refinement kernels do the same for a single color, but only
+    // consider the given candidates, which must be in ascending order;
+    // they may read up to 8 bytes past the last candidate
+    u8 RefineNearestScalar(const RGB& color, const u8* candidates, int count, const NearestTable& table);
+
+#if defined(AZURA_X86)
+    void FindNearestSSE2(const RGB* colors, int count, const NearestTable& table, u8* indices);
+    void FindNearestAVX2(const RGB* colors, int count, const NearestTable& table, u8* indices);
+
+    u8 RefineNearestAVX2(const RGB& color, const u8* candidates, int count, const NearestTable& table);
+#endif
+
+    //-----------------------------------------------------------------
+    inline
+    NearestCache::NearestCache()
+    {
+        // no key has all bits set
+        std::memset(_keys, 0xFF, sizeof(_keys));
+    }
+
+    //-----------------------------------------------------------------
+    inline int
+    NearestCache::GetSlot(u32 key)
+    {
+        return (int)((key * 2654435761u) >> 22);
+    }
+
+    //-----------------------------------------------------------------
+    inline bool
+    NearestCache::find(u32 key, u8& index) const
+    {
+        int slot = GetSlot(key);
+        if (_keys[slot] != key) {
+            return false;
+        }
+        index = _indices[slot];
+        return true;
+    }
+
+    //-----------------------------------------------------------------
+    inline void
+    NearestCache::set(u32 key, u8 index)
+    {
+        int slot = GetSlot(key);
+        _keys[slot] = key;
+        _indices[slot] = index;
+    }
+
+}
+
+
+#endif
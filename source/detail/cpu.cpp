@@ -0,0 +1,139 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <cstdlib>
+
+#include "cpu.hpp"
+
+#if defined(AZURA_X86)
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    else
+#        include <cpuid.h>
+#    endif
+#endif
+
+
+namespace azura {
+
+    namespace {
+
+#if defined(AZURA_X86)
+
+        void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+        {
+#   if defined(_MSC_VER)
+            int r[4];
+            __cpuidex(r, (int)leaf, (int)subleaf);
+            regs[0] = r[0];
+            regs[1] = r[1];
+            regs[2] = r[2];
+            regs[3] = r[3];
+#   else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#   endif
+        }
+
+        unsigned int xgetbv0()
+        {
+#   if defined(_MSC_VER)
+            return (unsigned int)_xgetbv(0);
+#   else
+            unsigned int eax, edx;
+            __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0));
+            return eax;
+#   endif
+        }
+
+        int DetectCpuFeatures()
+        {
+            unsigned int regs[4];
+
+            cpuid(0, 0, regs);
+            unsigned int max_leaf = regs[0];
+
+            if (max_leaf < 1) {
+                return 0;
+            }
+
+            int features = 0;
+
+            cpuid(1, 0, regs);
+            unsigned int ecx1 = regs[2];
+            unsigned int edx1 = regs[3];
+
+            if (edx1 & (1u << 26)) features |= CpuFeature::SSE2;
+            if (ecx1 & (1u <<  9)) features |= CpuFeature::SSSE3;
+            if (ecx1 & (1u << 19)) features |= CpuFeature::SSE41;
+
+            // the AVX register state must be enabled by the operating system
+            bool has_osxsave = (ecx1 & (1u << 27)) != 0;
+            unsigned int xcr0 = (has_osxsave ? xgetbv0() : 0);
+            bool os_avx    = (xcr0 & 0x06) == 0x06; // XMM and YMM state
+            bool os_avx512 = (xcr0 & 0xE6) == 0xE6; // additionally opmask and ZMM state
+
+            if (max_leaf >= 7 && os_avx) {
+                cpuid(7, 0, regs);
+                unsigned int ebx7 = regs[1];
+
+                if (ebx7 & (1u << 5)) features |= CpuFeature::AVX2;
+
+                if (os_avx512) {
+                    if (ebx7 & (1u << 16)) features |= CpuFeature::AVX512F;
+                    if (ebx7 & (1u << 30)) features |= CpuFeature::AVX512BW;
+                }
+            }
+
+            return features;
+        }
+
+#else
+
+        int DetectCpuFeatures()
+        {
+            return 0;
+        }
+
+#endif
+
+        int GetFeatures()
+        {
+            const char* force_scalar = std::getenv("AZURA_FORCE_SCALAR");
+            if (force_scalar && *force_scalar && !(force_scalar[0] == '0' && force_scalar[1] == 0)) {
+                return 0;
+            }
+
+            return DetectCpuFeatures();
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    int QueryCpuFeatures()
+    {
+        static int features = GetFeatures();
+        return features;
+    }
+
+}
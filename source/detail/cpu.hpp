@@ -0,0 +1,57 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_DETAIL_CPU_HPP_INCLUDED
+#define AZURA_DETAIL_CPU_HPP_INCLUDED
+
+#include "../cpu.hpp"
+
+
+#if defined(__i386__)   || \
+    defined(__x86_64__) || \
+    defined(_M_IX86)    || \
+    defined(_M_X64)
+#    define AZURA_X86
+#endif
+
+// lets a single function use instructions beyond the compiler's
+// baseline; MSVC accepts any intrinsic without special flags
+#if defined(AZURA_X86) && (defined(__GNUC__) || defined(__clang__))
+#    define AZURA_TARGET(isa) __attribute__((target(isa)))
+#else
+#    define AZURA_TARGET(isa)
+#endif
+
+
+namespace azura {
+
+    // returns the CpuFeature flags supported by both the processor and
+    // the operating system; if the environment variable AZURA_FORCE_SCALAR
+    // is set to anything but "0", no features are reported at all
+    int QueryCpuFeatures();
+
+}
+
+
+#endif
@@ -0,0 +1,266 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <cstring>
+
+#include "ArrayAutoPtr.hpp"
+#include "histogram.hpp"
+
+#define INITIAL_CAPACITY_LOG2 12
+#define MAX_HASHED_CELLS      (1 << 12) /* a hash table of up to 32 KB */
+
+
+namespace azura {
+
+    const u32 ColorHistogram::EmptyKey;
+    const u16 CellIndexTable::Unresolved;
+
+    //-----------------------------------------------------------------
+    ColorHistogram::ColorHistogram()
+        : _slots(0)
+        , _capacity(1 << INITIAL_CAPACITY_LOG2)
+        , _size(0)
+        , _shift(32 - INITIAL_CAPACITY_LOG2)
+    {
+        _slots = new ColorCell[_capacity];
+        std::memset(_slots, 0xFF, _capacity * sizeof(ColorCell));
+    }
+
+    //-----------------------------------------------------------------
+    ColorHistogram::~ColorHistogram()
+    {
+        delete[] _slots;
+    }
+
+    //-----------------------------------------------------------------
+    void
+    ColorHistogram::clear()
+    {
+        // keep the current capacity for reuse
+        std::memset(_slots, 0xFF, _capacity * sizeof(ColorCell));
+        _size = 0;
+    }
+
+    //-----------------------------------------------------------------
+    ColorCell*
+    ColorHistogram::insert(u32 key)
+    {
+        u32 mask = _capacity - 1;
+        u32 slot = (key * 2654435761u) >> _shift;
+
+        while (_slots[slot].key != key) {
+            if (_slots[slot].key == EmptyKey) {
+                // keep the load factor at or below one half
+                if ((_size + 1) * 2 > _capacity) {
+                    grow();
+                    return insert(key);
+                }
+
+                ColorCell* cell = _slots + slot;
+                cell->key     = key;
+                cell->count   = 0;
+                cell->ones[0] = 0;
+                cell->ones[1] = 0;
+                cell->ones[2] = 0;
+                _size++;
+                return cell;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        return _slots + slot;
+    }
+
+    //-----------------------------------------------------------------
+    void
+    ColorHistogram::addPixels(const RGB* pixels, int count)
+    {
+        u32 last_key = EmptyKey;
+        ColorCell* cell = 0;
+
+        for (int i = 0; i < count; i++) {
+            u8 r = pixels[i].red;
+            u8 g = pixels[i].green;
+            u8 b = pixels[i].blue;
+            u32 key = GetCellKey(r, g, b);
+
+            // neighboring pixels tend to fall into the same cell
+            if (key != last_key) {
+                cell = insert(key);
+                last_key = key;
+            }
+
+            cell->count++;
+            cell->ones[0] += r & 1;
+            cell->ones[1] += g & 1;
+            cell->ones[2] += b & 1;
+        }
+    }
+
+    //-----------------------------------------------------------------
+    void
+    ColorHistogram::addCell(const ColorCell& cell)
+    {
+        ColorCell* dst = insert(cell.key);
+
+        dst->count   += cell.count;
+        dst->ones[0] += cell.ones[0];
+        dst->ones[1] += cell.ones[1];
+        dst->ones[2] += cell.ones[2];
+    }
+
+    //-----------------------------------------------------------------
+    void
+    ColorHistogram::merge(const ColorHistogram& other)
+    {
+        for (int i = 0; i < other._capacity; i++) {
+            if (other._slots[i].key != EmptyKey) {
+                addCell(other._slots[i]);
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------
+    void
+    ColorHistogram::grow()
+    {
+        ColorCell* old_slots = _slots;
+        int old_capacity = _capacity;
+
+        _capacity *= 2;
+        _shift -= 1;
+        _size = 0;
+        _slots = new ColorCell[_capacity];
+        std::memset(_slots, 0xFF, _capacity * sizeof(ColorCell));
+
+        for (int i = 0; i < old_capacity; i++) {
+            if (old_slots[i].key != EmptyKey) {
+                *insert(old_slots[i].key) = old_slots[i];
+            }
+        }
+
+        delete[] old_slots;
+    }
+
+    //-----------------------------------------------------------------
+    void
+    ColorHistogram::getSortedCells(ColorCell* cells) const
+    {
+        if (_size == 0) {
+            return;
+        }
+
+        ArrayAutoPtr<ColorCell> tmp = new ColorCell[_size];
+
+        // gather the occupied slots
+        int n = 0;
+        for (int i = 0; i < _capacity; i++) {
+            if (_slots[i].key != EmptyKey) {
+                tmp[n++] = _slots[i];
+            }
+        }
+
+        // LSD radix sort over the three 7 bit channels of the key,
+        // ending up back in the caller's array after the odd pass count
+        ColorCell* src = tmp.get();
+        ColorCell* dst = cells;
+
+        for (int shift = 0; shift < 21; shift += 7) {
+            int offsets[128];
+            std::memset(offsets, 0, sizeof(offsets));
+
+            for (int i = 0; i < n; i++) {
+                offsets[(src[i].key >> shift) & 0x7F]++;
+            }
+
+            int sum = 0;
+            for (int i = 0; i < 128; i++) {
+                int c = offsets[i];
+                offsets[i] = sum;
+                sum += c;
+            }
+
+            for (int i = 0; i < n; i++) {
+                dst[offsets[(src[i].key >> shift) & 0x7F]++] = src[i];
+            }
+
+            ColorCell* t = src;
+            src = dst;
+            dst = t;
+        }
+    }
+
+    //-----------------------------------------------------------------
+    CellIndexTable::CellIndexTable()
+        : _indices(0)
+        , _slots(0)
+        , _slotsAlloc(0)
+        , _capacity(0)
+        , _shift(0)
+        , _isHashed(false)
+    {
+    }
+
+    //-----------------------------------------------------------------
+    CellIndexTable::~CellIndexTable()
+    {
+        delete[] _indices;
+        delete[] _slots;
+    }
+
+    //-----------------------------------------------------------------
+    void
+    CellIndexTable::clear(int cells_count)
+    {
+        // the tables are allocated on first use, then kept for reuse
+        _isHashed = (cells_count <= MAX_HASHED_CELLS);
+
+        if (!_isHashed) {
+            if (!_indices) {
+                _indices = new u16[CellKeyCount];
+            }
+
+            std::memset(_indices, 0xFF, CellKeyCount * sizeof(u16));
+            return;
+        }
+
+        // keep the load factor at or below one half
+        int capacity_log2 = INITIAL_CAPACITY_LOG2;
+        while ((1 << capacity_log2) < cells_count * 2) {
+            capacity_log2++;
+        }
+
+        _capacity = 1 << capacity_log2;
+        _shift = 32 - capacity_log2;
+
+        if (_slotsAlloc < _capacity) {
+            delete[] _slots;
+            _slots = new u32[_capacity];
+            _slotsAlloc = _capacity;
+        }
+
+        std::memset(_slots, 0xFF, _capacity * sizeof(u32));
+    }
+
+}
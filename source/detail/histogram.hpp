@@ -0,0 +1,234 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_HISTOGRAM_HPP_INCLUDED
+#define AZURA_HISTOGRAM_HPP_INCLUDED
+
+#include "../types.hpp"
+#include "../color.hpp"
+
+
+namespace azura {
+
+    // A color cell covers the colors sharing the upper 7 bits of each
+    // channel. Counting how often the dropped lowest bit is set keeps
+    // the sum of all colors in a cell exact.
+    struct ColorCell {
+        u32 key;
+        u32 count;
+        u32 ones[3]; /* red, green, blue */
+    };
+
+    // number of distinct cell keys
+    const u32 CellKeyCount = 1 << 21;
+
+    inline u32 GetCellKey(u8 r, u8 g, u8 b)
+    {
+        return ((u32)(r >> 1) << 14) | ((u32)(g >> 1) << 7) | (u32)(b >> 1);
+    }
+
+    inline u32 GetCellKey(const RGB& c)
+    {
+        return GetCellKey(c.red, c.green, c.blue);
+    }
+
+    // returns the color in the middle of the cell
+    inline RGB GetCellCenter(u32 key)
+    {
+        RGB c;
+        c.red   = (u8)((((key >> 14) & 0x7F) << 1) + 1);
+        c.green = (u8)((((key >>  7) & 0x7F) << 1) + 1);
+        c.blue  = (u8)(((key & 0x7F) << 1) + 1);
+        return c;
+    }
+
+    // returns the sum of all colors in the cell for channel c (0 = red)
+    inline u64 GetCellSum(const ColorCell& cell, int c)
+    {
+        u32 hi = (cell.key >> (14 - c * 7)) & 0x7F;
+        return (u64)cell.count * (hi << 1) + cell.ones[c];
+    }
+
+    // counts colors in an open addressing hash table of color cells
+    class ColorHistogram {
+    public:
+        static const u32 EmptyKey = 0xFFFFFFFF;
+
+        ColorHistogram();
+        ~ColorHistogram();
+
+        void clear();
+
+        void addPixels(const RGB* pixels, int count);
+        void addCell(const ColorCell& cell);
+        void merge(const ColorHistogram& other);
+
+        int getCellCount() const;
+        int getCapacity() const;
+        const ColorCell* getSlots() const;
+
+        // returns the slot holding the cell, or -1 if it is empty
+        int findSlot(u32 key) const;
+
+        // copies all non-empty cells in ascending key order
+        void getSortedCells(ColorCell* cells) const;
+
+    private:
+        ColorHistogram(const ColorHistogram&);
+        ColorHistogram& operator=(const ColorHistogram&);
+
+        ColorCell* insert(u32 key);
+        void grow();
+
+    private:
+        ColorCell* _slots;
+        int _capacity;
+        int _size;
+        int _shift;
+    };
+
+    //-----------------------------------------------------------------
+    inline int
+    ColorHistogram::getCellCount() const
+    {
+        return _size;
+    }
+
+    //-----------------------------------------------------------------
+    inline int
+    ColorHistogram::getCapacity() const
+    {
+        return _capacity;
+    }
+
+    //-----------------------------------------------------------------
+    inline const ColorCell*
+    ColorHistogram::getSlots() const
+    {
+        return _slots;
+    }
+
+    //-----------------------------------------------------------------
+    inline int
+    ColorHistogram::findSlot(u32 key) const
+    {
+        u32 mask = _capacity - 1;
+        u32 slot = (key * 2654435761u) >> _shift;
+
+        while (_slots[slot].key != key) {
+            if (_slots[slot].key == EmptyKey) {
+                return -1;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        return (int)slot;
+    }
+
+    // maps every possible color cell to a palette index; buildPalette()
+    // fills in the cells of the histogram and leaves the others
+    // unresolved; while mapping, the table is shared by all threads and
+    // only read, so cells that are still unresolved must be matched
+    // into a per-thread NearestCache, never stored here
+    //
+    // a few cells are kept in an open addressing hash table sized from
+    // their count, so that small images don't pay for clearing an entry
+    // for each of the CellKeyCount keys; many cells get such entries
+    class CellIndexTable {
+    public:
+        static const u16 Unresolved = 0xFFFF;
+
+        CellIndexTable();
+        ~CellIndexTable();
+
+        // marks all cells as unresolved, making room for set() to be
+        // called with up to cells_count distinct keys
+        void clear(int cells_count);
+
+        u16 get(u32 key) const;
+        void set(u32 key, u8 index);
+
+    private:
+        CellIndexTable(const CellIndexTable&);
+        CellIndexTable& operator=(const CellIndexTable&);
+
+    private:
+        u16* _indices; /* one entry per key, if there are many cells */
+
+        u32* _slots;   /* key in the low 21 bits, index above, if there are few */
+        int _slotsAlloc;
+        int _capacity;
+        int _shift;
+
+        bool _isHashed;
+    };
+
+    //-----------------------------------------------------------------
+    inline u16
+    CellIndexTable::get(u32 key) const
+    {
+        if (!_isHashed) {
+            return _indices[key];
+        }
+
+        u32 mask = _capacity - 1;
+        u32 slot = (key * 2654435761u) >> _shift;
+
+        for (;;) {
+            u32 entry = _slots[slot];
+
+            if (entry == ColorHistogram::EmptyKey) {
+                return Unresolved;
+            }
+            if ((entry & (CellKeyCount - 1)) == key) {
+                return (u16)(entry >> 21);
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    //-----------------------------------------------------------------
+    inline void
+    CellIndexTable::set(u32 key, u8 index)
+    {
+        if (!_isHashed) {
+            _indices[key] = index;
+            return;
+        }
+
+        u32 mask = _capacity - 1;
+        u32 slot = (key * 2654435761u) >> _shift;
+
+        while (_slots[slot] != ColorHistogram::EmptyKey && (_slots[slot] & (CellKeyCount - 1)) != key) {
+            slot = (slot + 1) & mask;
+        }
+
+        _slots[slot] = key | ((u32)index << 21);
+    }
+
+}
+
+
+#endif
@@ -0,0 +1,332 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include <cassert>
+#include <cstring>
+
+#include "inversecmap.hpp"
+#include "kernels.hpp"
+#include "thread.hpp"
+
+#if defined(AZURA_X86)
+#    include <immintrin.h>
+#endif
+
+#define CELL_SIZE   4  /* values per channel */
+#define BLOCK_SIZE  16
+#define TOP_SIZE    64
+#define CELL_COUNT  (64 * 64 * 64)
+#define BLOCK_COUNT (16 * 16 * 16)
+#define TOP_COUNT   (4 * 4 * 4)
+#define PADDING     8 /* the refinement kernels may read past the last candidate */
+
+
+namespace azura {
+
+    namespace {
+
+        // squared distances from a color to the nearest and the farthest
+        // point of the box [lo, lo + size)
+        inline void get_box_distances(const RGB& c, const int lo[3], int size, int& dmin, int& dmax)
+        {
+            int channels[3] = { c.red, c.green, c.blue };
+
+            dmin = 0;
+            dmax = 0;
+
+            for (int i = 0; i < 3; i++) {
+                int hi = lo[i] + size - 1;
+                int near_d = 0;
+                int far_d;
+
+                if (channels[i] < lo[i]) {
+                    near_d = lo[i] - channels[i];
+                    far_d  = hi - channels[i];
+                } else if (channels[i] > hi) {
+                    near_d = channels[i] - hi;
+                    far_d  = channels[i] - lo[i];
+                } else {
+                    int d1 = channels[i] - lo[i];
+                    int d2 = hi - channels[i];
+                    far_d = (d1 > d2 ? d1 : d2);
+                }
+
+                dmin += near_d * near_d;
+                dmax += far_d * far_d;
+            }
+        }
+
+    }
+
+    // the top level boxes are independent of each other
+    class InverseColormapTask : public ParallelTask {
+    public:
+        explicit InverseColormapTask(InverseColormap& colormap)
+            : _colormap(colormap)
+        {
+        }
+
+        void run(int part) {
+            _colormap.buildTop(part);
+        }
+
+    private:
+        InverseColormap& _colormap;
+    };
+
+    //--------------------------------------------------------------
+    InverseColormap::InverseColormap(const RGB* palette, int size)
+        : _size(size)
+        , _records(0)
+        , _blockCandidates(0)
+        , _blockCounts(0)
+    {
+        assert(size > 0 && size <= 256);
+
+        std::memcpy(_palette, palette, size * sizeof(RGB));
+        BuildNearestTable(palette, size, _table);
+
+        _records = new u8[CELL_COUNT * 16];
+        _blockCandidates = new u8[BLOCK_COUNT * 256 + PADDING];
+        _blockCounts = new u16[BLOCK_COUNT];
+
+        std::memset(_blockCandidates + BLOCK_COUNT * 256, 0, PADDING);
+
+        InverseColormapTask task(*this);
+        RunParallel(task, TOP_COUNT);
+    }
+
+    //--------------------------------------------------------------
+    InverseColormap::~InverseColormap()
+    {
+        delete[] _records;
+        delete[] _blockCandidates;
+        delete[] _blockCounts;
+    }
+
+    //--------------------------------------------------------------
+    int
+    InverseColormap::selectCandidates(const u8* entries, int count, const int lo[3], int size, u8* result) const
+    {
+        int dmin[256];
+        int bound = 0x7FFFFFFF;
+
+        // no color in the box is farther from its nearest entry than bound
+        for (int i = 0; i < count; i++) {
+            int dmax;
+            get_box_distances(_palette[entries[i]], lo, size, dmin[i], dmax);
+
+            if (dmax < bound) {
+                bound = dmax;
+            }
+        }
+
+        // so entries that are farther than that from the whole box can't
+        // be the nearest one for any color in it; the order is kept, so
+        // ties still go to the lowest index
+        int n = 0;
+
+        for (int i = 0; i < count; i++) {
+            if (dmin[i] <= bound) {
+                result[n++] = entries[i];
+            }
+        }
+
+        return n;
+    }
+
+    //--------------------------------------------------------------
+    void
+    InverseColormap::buildTop(int top)
+    {
+        u8 entries[256];
+        for (int i = 0; i < _size; i++) {
+            entries[i] = (u8)i;
+        }
+
+        int lo[3] = {
+            (top >> 4) * TOP_SIZE,
+            ((top >> 2) & 3) * TOP_SIZE,
+            (top & 3) * TOP_SIZE,
+        };
+
+        buildBox(lo, TOP_SIZE, entries, _size);
+    }
+
+    //--------------------------------------------------------------
+    void
+    InverseColormap::buildBox(const int lo[3], int size, const u8* entries, int count)
+    {
+        // the candidates of a box are a subset of those of any box
+        // containing it, so they are narrowed down while halving the box
+        u8 candidates[256];
+        int candidates_count = selectCandidates(entries, count, lo, size, candidates);
+
+        if (size == BLOCK_SIZE) {
+            int block = ((lo[0] / BLOCK_SIZE) << 8) | ((lo[1] / BLOCK_SIZE) << 4) | (lo[2] / BLOCK_SIZE);
+
+            std::memcpy(_blockCandidates + block * 256, candidates, candidates_count);
+            _blockCounts[block] = (u16)candidates_count;
+        }
+
+        if (size == CELL_SIZE) {
+            RGB color = { (u8)lo[0], (u8)lo[1], (u8)lo[2] };
+            u8* record = const_cast<u8*>(getCellRecord(color));
+
+            if (candidates_count > 4) {
+                std::memset(record, 0, 16);
+                record[12] = 1; /* marks the overflow */
+                return;
+            }
+
+            for (int i = 0; i < 4; i++) {
+                int k = (i < candidates_count ? i : candidates_count - 1);
+                const RGB& e = _palette[candidates[k]];
+
+                record[i * 2]     = e.red;
+                record[i * 2 + 1] = e.green;
+                record[8 + i]     = e.blue;
+                record[12 + i]    = candidates[k];
+            }
+
+            return;
+        }
+
+        int half = size / 2;
+
+        for (int i = 0; i < 8; i++) {
+            int child_lo[3] = {
+                lo[0] + ((i >> 2) & 1) * half,
+                lo[1] + ((i >> 1) & 1) * half,
+                lo[2] + (i & 1) * half,
+            };
+
+            buildBox(child_lo, half, candidates, candidates_count);
+        }
+    }
+
+    //--------------------------------------------------------------
+    u8
+    InverseColormap::refineNearest(const RGB& color) const
+    {
+        int block = ((color.red >> 4) << 8) | ((color.green >> 4) << 4) | (color.blue >> 4);
+        return GetKernels().refineNearest(color, _blockCandidates + block * 256, _blockCounts[block], _table);
+    }
+
+    //--------------------------------------------------------------
+    u8
+    InverseColormap::findNearest(const RGB& color) const
+    {
+        u8 index;
+        GetKernels().mapInverse(*this, &color, 1, &index);
+        return index;
+    }
+
+    //--------------------------------------------------------------
+    void
+    InverseColormap::mapPixels(const RGB* pixels, int count, u8* indices) const
+    {
+        GetKernels().mapInverse(*this, pixels, count, indices);
+    }
+
+    //--------------------------------------------------------------
+    void MapInverseScalar(const InverseColormap& colormap, const RGB* pixels, int count, u8* indices)
+    {
+        for (int i = 0; i < count; i++) {
+            const RGB& p = pixels[i];
+            const u8* record = colormap.getCellRecord(p);
+
+            if (InverseColormap::IsOverflowRecord(record)) {
+                indices[i] = colormap.refineNearest(p);
+                continue;
+            }
+
+            int best_dist = 0x7FFFFFFF;
+            int best_index = 0;
+
+            // written to compile into conditional moves, the outcome
+            // of the comparisons is hard to predict
+            for (int j = 0; j < 4; j++) {
+                int dr = record[j * 2]     - p.red;
+                int dg = record[j * 2 + 1] - p.green;
+                int db = record[8 + j]     - p.blue;
+                int dist = dr * dr + dg * dg + db * db;
+
+                bool closer = (dist < best_dist);
+                best_dist  = (closer ? dist : best_dist);
+                best_index = (closer ? record[12 + j] : best_index);
+            }
+
+            indices[i] = (u8)best_index;
+        }
+    }
+
+#if defined(AZURA_X86)
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("sse2")
+    void MapInverseSSE2(const InverseColormap& colormap, const RGB* pixels, int count, u8* indices)
+    {
+        const __m128i zero  = _mm_setzero_si128();
+        const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+        for (int i = 0; i < count; i++) {
+            const RGB& p = pixels[i];
+            const u8* record = colormap.getCellRecord(p);
+
+            if (InverseColormap::IsOverflowRecord(record)) {
+                indices[i] = colormap.refineNearest(p);
+                continue;
+            }
+
+            __m128i v = _mm_loadu_si128((const __m128i*)record);
+
+            // r0 g0 r1 g1 r2 g2 r3 g3 and b0 b1 b2 b3 as 16 bit values
+            __m128i rg = _mm_unpacklo_epi8(v, zero);
+            __m128i b  = _mm_unpacklo_epi8(_mm_srli_si128(v, 8), zero);
+
+            __m128i drg = _mm_sub_epi16(rg, _mm_set1_epi32(p.red | (p.green << 16)));
+            __m128i db  = _mm_unpacklo_epi16(_mm_sub_epi16(b, _mm_set1_epi16(p.blue)), zero);
+
+            // pairwise multiply-add yields dr * dr + dg * dg and db * db
+            __m128i dist = _mm_add_epi32(_mm_madd_epi16(drg, drg), _mm_madd_epi16(db, db));
+
+            // the lane in the low bits makes the keys unique, so the
+            // minimum picks the first of equally distant candidates
+            __m128i key = _mm_or_si128(_mm_slli_epi32(dist, 2), lanes);
+
+            __m128i other = _mm_shuffle_epi32(key, _MM_SHUFFLE(2, 3, 0, 1));
+            __m128i less  = _mm_cmplt_epi32(other, key);
+            key = _mm_or_si128(_mm_and_si128(less, other), _mm_andnot_si128(less, key));
+
+            other = _mm_shuffle_epi32(key, _MM_SHUFFLE(1, 0, 3, 2));
+            less  = _mm_cmplt_epi32(other, key);
+            key = _mm_or_si128(_mm_and_si128(less, other), _mm_andnot_si128(less, key));
+
+            indices[i] = record[12 + (_mm_cvtsi128_si32(key) & 3)];
+        }
+    }
+
+#endif
+
+}
@@ -0,0 +1,104 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_INVERSECMAP_HPP_INCLUDED
+#define AZURA_INVERSECMAP_HPP_INCLUDED
+
+#include "../types.hpp"
+#include "../color.hpp"
+#include "colormatch.hpp"
+
+
+namespace azura {
+
+    // finds the nearest entry of an arbitrary palette quickly: the color
+    // space is divided into 4x4x4 cells, each listing the (at most four)
+    // palette entries that can be the nearest one for some color in the
+    // cell, so that a pixel only needs a few exact distance checks; cells
+    // with more candidates fall back to the candidates of the enclosing
+    // 16x16x16 block
+    class InverseColormap {
+    public:
+        InverseColormap(const RGB* palette, int size);
+        ~InverseColormap();
+
+        u8 findNearest(const RGB& color) const;
+
+        // may be called from several threads at once
+        void mapPixels(const RGB* pixels, int count, u8* indices) const;
+
+        // a cell record holds the candidates as r0 g0 r1 g1 r2 g2 r3 g3,
+        // b0 b1 b2 b3 and their palette indices i0 i1 i2 i3, in ascending
+        // index order and padded by repeating the last one
+        const u8* getCellRecord(const RGB& color) const;
+        static bool IsOverflowRecord(const u8* record);
+
+        // finds the nearest entry among the candidates of the color's block
+        u8 refineNearest(const RGB& color) const;
+
+    private:
+        InverseColormap(const InverseColormap&);
+        InverseColormap& operator=(const InverseColormap&);
+
+        friend class InverseColormapTask;
+        void buildTop(int top);
+        void buildBox(const int lo[3], int size, const u8* entries, int count);
+        int selectCandidates(const u8* entries, int count, const int lo[3], int size, u8* result) const;
+
+    private:
+        RGB _palette[256];
+        int _size;
+        NearestTable _table;
+
+        u8* _records;         /* 16 bytes per cell */
+        u8* _blockCandidates; /* 256 bytes per block */
+        u16* _blockCounts;
+    };
+
+    // the mapping kernels
+    void MapInverseScalar(const InverseColormap& colormap, const RGB* pixels, int count, u8* indices);
+
+#if defined(AZURA_X86)
+    void MapInverseSSE2(const InverseColormap& colormap, const RGB* pixels, int count, u8* indices);
+#endif
+
+    //--------------------------------------------------------------
+    inline const u8*
+    InverseColormap::getCellRecord(const RGB& color) const
+    {
+        u32 cell = ((u32)(color.red >> 2) << 12) | ((u32)(color.green >> 2) << 6) | (u32)(color.blue >> 2);
+        return _records + cell * 16;
+    }
+
+    //--------------------------------------------------------------
+    inline bool
+    InverseColormap::IsOverflowRecord(const u8* record)
+    {
+        // regular records never have descending indices
+        return record[12] > record[13];
+    }
+
+}
+
+
+#endif
@@ -28,6 +28,7 @@
 #include <jpeglib.h>
 
 #include "../ImageImpl.hpp"
+#include "../PlanarImageImpl.hpp"
 #include "jpeg.hpp"
 
 #define INPUT_BUF_SIZE  4096
@@ -217,6 +218,135 @@ namespace azura {
         return image;
     }
 
+    //-----------------------------------------------------------------
+    static PlanarFormat::Enum get_planar_format(jpeg_decompress_struct* cinfo)
+    {
+        if (cinfo->jpeg_color_space == JCS_GRAYSCALE && cinfo->num_components == 1) {
+            return PlanarFormat::Y8;
+        }
+
+        if (cinfo->jpeg_color_space != JCS_YCbCr || cinfo->num_components != 3) {
+            return PlanarFormat::Unknown;
+        }
+
+        jpeg_component_info* y  = &cinfo->comp_info[0];
+        jpeg_component_info* cb = &cinfo->comp_info[1];
+        jpeg_component_info* cr = &cinfo->comp_info[2];
+
+        if (cb->h_samp_factor != 1 || cb->v_samp_factor != 1 ||
+            cr->h_samp_factor != 1 || cr->v_samp_factor != 1)
+        {
+            // we support only subsampled chroma
+            return PlanarFormat::Unknown;
+        }
+
+        if (y->h_samp_factor == 1 && y->v_samp_factor == 1) return PlanarFormat::YUV444;
+        if (y->h_samp_factor == 2 && y->v_samp_factor == 1) return PlanarFormat::YUV422;
+        if (y->h_samp_factor == 2 && y->v_samp_factor == 2) return PlanarFormat::YUV420;
+        if (y->h_samp_factor == 1 && y->v_samp_factor == 2) return PlanarFormat::YUV440;
+        if (y->h_samp_factor == 4 && y->v_samp_factor == 1) return PlanarFormat::YUV411;
+
+        return PlanarFormat::Unknown;
+    }
+
+    //-----------------------------------------------------------------
+    static bool read_planar_data(jpeg_decompress_struct* cinfo, my_jpeg_error_mgr* my_jerr, PlanarImage* image)
+    {
+        // row pointers for one iMCU row per component
+        JSAMPROW rows[3][MAX_SAMP_FACTOR * DCTSIZE];
+        JSAMPARRAY planes[3] = { rows[0], rows[1], rows[2] };
+
+        // errors while decoding come back here, the caller still owns the image
+        if (setjmp(my_jerr->env) != 0) {
+            return false;
+        }
+
+        // read image data, one iMCU row at a time
+        int num_planes = image->getPlaneCount();
+        int imcu_row = 0;
+        while (cinfo->output_scanline < cinfo->output_height) {
+            for (int i = 0; i < num_planes; i++) {
+                int rows_per_imcu = cinfo->comp_info[i].v_samp_factor * DCTSIZE;
+                u8* plane = image->getPlane(i);
+                int pitch = image->getPlanePitch(i);
+
+                for (int j = 0; j < rows_per_imcu; j++) {
+                    rows[i][j] = (JSAMPROW)(plane + (imcu_row * rows_per_imcu + j) * pitch);
+                }
+            }
+
+            if (jpeg_read_raw_data(cinfo, planes, cinfo->max_v_samp_factor * DCTSIZE) == 0) {
+                return false;
+            }
+
+            imcu_row++;
+        }
+
+        // finish decompression
+        jpeg_finish_decompress(cinfo);
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------
+    PlanarImage::Ptr ReadPlanarJPEG(File* file)
+    {
+        if (!file) {
+            return 0;
+        }
+
+        my_jpeg_error_mgr my_jerr;
+        my_jpeg_source_mgr my_jsrc(file);
+        jpeg_decompress_struct cinfo;
+
+        // set error manager
+        cinfo.err = (jpeg_error_mgr*)&my_jerr;
+
+        // save calling environment for long jump
+        if (setjmp(my_jerr.env) != 0) {
+            // if we get here, the JPEG code has signaled an error.
+            jpeg_destroy_decompress(&cinfo);
+            return 0;
+        }
+
+        // initialize JPEG decompression object
+        jpeg_create_decompress(&cinfo);
+
+        // set source manager
+        cinfo.src = (jpeg_source_mgr*)&my_jsrc;
+
+        // read image header
+        jpeg_read_header(&cinfo, TRUE);
+
+        PlanarFormat::Enum pf = get_planar_format(&cinfo);
+        if (pf == PlanarFormat::Unknown) {
+            jpeg_destroy_decompress(&cinfo);
+            return 0;
+        }
+
+        // we want the decoded components as they are stored, raw data
+        // output skips upsampling and color conversion
+        cinfo.out_color_space = cinfo.jpeg_color_space;
+        cinfo.raw_data_out = TRUE;
+
+        // start decompression
+        jpeg_start_decompress(&cinfo);
+
+        // the image is allocated only now and decoded in a function of its
+        // own, so that no smart pointer lives across a setjmp()
+        PlanarImage::Ptr image = new PlanarImageImpl(cinfo.image_width, cinfo.image_height, pf);
+        bool succeeded = read_planar_data(&cinfo, &my_jerr, image.get());
+
+        // release JPEG decompression object
+        jpeg_destroy_decompress(&cinfo);
+
+        if (!succeeded) {
+            return 0;
+        }
+
+        return image;
+    }
+
     //-----------------------------------------------------------------
     static void my_init_destination(j_compress_ptr cinfo);
     static boolean my_empty_output_buffer(j_compress_ptr cinfo);
@@ -27,11 +27,13 @@
 
 #include "../../File.hpp"
 #include "../../Image.hpp"
+#include "../../PlanarImage.hpp"
 
 
 namespace azura {
 
     Image::Ptr ReadJPEG(File* file);
+    PlanarImage::Ptr ReadPlanarJPEG(File* file);
     bool WriteJPEG(Image* image, File* file);
 
 }
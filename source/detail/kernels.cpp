@@ -0,0 +1,134 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <cassert>
+
+#include "cpu.hpp"
+#include "kernels.hpp"
+#include "pixelconv.hpp"
+#include "colormatch.hpp"
+#include "inversecmap.hpp"
+#include "png/pngfilter.hpp"
+#include "png/pngreduce.hpp"
+
+
+namespace azura {
+
+    namespace {
+
+        KernelInfo KernelInfos[] = {
+            { "SwizzlePixels",   "scalar" },
+            { "ExpandIndexed",   "scalar" },
+            { "FindNearest",     "scalar" },
+            { "RefineNearest",   "scalar" },
+            { "MapInverse",      "scalar" },
+            { "UnpackBitfields", "scalar" },
+            { "ClassifyPixels",  "scalar" },
+            { "FilterRow",       "scalar" },
+        };
+
+        Kernels SelectKernels()
+        {
+            Kernels k;
+
+            k.swizzlePixels   = SwizzlePixelsScalar;
+            k.expandIndexed   = ExpandIndexedScalar;
+            k.findNearest     = FindNearestScalar;
+            k.refineNearest   = RefineNearestScalar;
+            k.mapInverse      = MapInverseScalar;
+            k.unpackBitfields = UnpackBitfieldsScalar;
+            k.classifyPixels  = ClassifyPixelsScalar;
+            k.filterRow       = FilterRowScalar;
+
+#if defined(AZURA_X86)
+            int features = QueryCpuFeatures();
+
+            if (features & CpuFeature::SSE2) {
+                k.findNearest = FindNearestSSE2;
+                KernelInfos[Kernel::FindNearest].path = "sse2";
+
+                k.mapInverse = MapInverseSSE2;
+                KernelInfos[Kernel::MapInverse].path = "sse2";
+
+                k.unpackBitfields = UnpackBitfieldsSSE2;
+                KernelInfos[Kernel::UnpackBitfields].path = "sse2";
+
+                k.classifyPixels = ClassifyPixelsSSE2;
+                KernelInfos[Kernel::ClassifyPixels].path = "sse2";
+
+                k.filterRow = FilterRowSSE2;
+                KernelInfos[Kernel::FilterRow].path = "sse2";
+            }
+
+            if (features & CpuFeature::SSSE3) {
+                k.swizzlePixels = SwizzlePixelsSSSE3;
+                KernelInfos[Kernel::SwizzlePixels].path = "ssse3";
+            }
+
+            if (features & CpuFeature::AVX2) {
+                k.expandIndexed = ExpandIndexedAVX2;
+                KernelInfos[Kernel::ExpandIndexed].path = "avx2";
+
+                k.findNearest = FindNearestAVX2;
+                KernelInfos[Kernel::FindNearest].path = "avx2";
+
+                k.refineNearest = RefineNearestAVX2;
+                KernelInfos[Kernel::RefineNearest].path = "avx2";
+
+                k.unpackBitfields = UnpackBitfieldsAVX2;
+                KernelInfos[Kernel::UnpackBitfields].path = "avx2";
+
+                k.classifyPixels = ClassifyPixelsAVX2;
+                KernelInfos[Kernel::ClassifyPixels].path = "avx2";
+
+                k.filterRow = FilterRowAVX2;
+                KernelInfos[Kernel::FilterRow].path = "avx2";
+            }
+#endif
+
+            return k;
+        }
+
+        // make sure the selection happens during static initialization,
+        // before any threads get a chance to race for it
+        const Kernels& InitKernels = GetKernels();
+
+    }
+
+    //--------------------------------------------------------------
+    const Kernels& GetKernels()
+    {
+        static Kernels kernels = SelectKernels();
+        return kernels;
+    }
+
+    //--------------------------------------------------------------
+    const KernelInfo& GetKernelInfo(Kernel::Enum k)
+    {
+        assert(k >= 0 && k < Kernel::Count);
+        GetKernels();
+        return KernelInfos[k];
+    }
+
+}
@@ -0,0 +1,85 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_KERNELS_HPP_INCLUDED
+#define AZURA_KERNELS_HPP_INCLUDED
+
+#include "../types.hpp"
+#include "../Image.hpp"
+#include "colormatch.hpp"
+#include "inversecmap.hpp"
+#include "pixelconv.hpp"
+#include "png/pngfilter.hpp"
+#include "png/pngreduce.hpp"
+
+
+namespace azura {
+
+    struct Kernel {
+        enum Enum {
+            SwizzlePixels   = 0,
+            ExpandIndexed   = 1,
+            FindNearest     = 2,
+            RefineNearest   = 3,
+            MapInverse      = 4,
+            UnpackBitfields = 5,
+            ClassifyPixels  = 6,
+            FilterRow       = 7,
+            Count,
+        };
+    };
+
+    struct KernelInfo {
+        const char* name;
+        const char* path;
+    };
+
+    typedef void (*SwizzlePixelsFunc)(const u8* src, const PixelFormatDescriptor& spfd, u8* dst, const PixelFormatDescriptor& dpfd, int count);
+    typedef void (*ExpandIndexedFunc)(const u8* src, int count, const u8 table[256][4], int bpp, u8* dst);
+    typedef void (*FindNearestFunc)(const RGB* colors, int count, const NearestTable& table, u8* indices);
+    typedef u8 (*RefineNearestFunc)(const RGB& color, const u8* candidates, int count, const NearestTable& table);
+    typedef void (*MapInverseFunc)(const InverseColormap& colormap, const RGB* pixels, int count, u8* indices);
+    typedef void (*UnpackBitfieldsFunc)(const u8* src, int sbpp, int count, const BitfieldsLayout& layout, u8* dst);
+    typedef int (*ClassifyPixelsFunc)(const u8* src, int bpp, int count, int traits);
+    typedef u32 (*FilterRowFunc)(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst, u32 limit);
+
+    struct Kernels {
+        SwizzlePixelsFunc swizzlePixels;
+        ExpandIndexedFunc expandIndexed;
+        FindNearestFunc findNearest;
+        RefineNearestFunc refineNearest;
+        MapInverseFunc mapInverse;
+        UnpackBitfieldsFunc unpackBitfields;
+        ClassifyPixelsFunc classifyPixels;
+        FilterRowFunc filterRow;
+    };
+
+    // the kernels are selected once, based on QueryCpuFeatures()
+    const Kernels& GetKernels();
+    const KernelInfo& GetKernelInfo(Kernel::Enum k);
+
+}
+
+
+#endif
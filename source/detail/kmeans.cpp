@@ -0,0 +1,239 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include <cstring>
+
+#include "ArrayAutoPtr.hpp"
+#include "kernels.hpp"
+#include "kmeans.hpp"
+#include "thread.hpp"
+
+#define MIN_PART_SIZE 4096 /* colors */
+
+
+namespace azura {
+
+    namespace {
+
+        // matches the colors in parts, each color independently of the others
+        class FindNearestTask : public ParallelTask {
+        public:
+            FindNearestTask(const RGB* colors, int count, const NearestTable& table, u8* indices, int parts)
+                : _colors(colors), _count(count), _table(table), _indices(indices), _parts(parts)
+            {
+            }
+
+            void run(int part) {
+                int begin = (int)((i64)_count * part / _parts);
+                int end = (int)((i64)_count * (part + 1) / _parts);
+                GetKernels().findNearest(_colors + begin, end - begin, _table, _indices + begin);
+            }
+
+        private:
+            const RGB* _colors;
+            int _count;
+            const NearestTable& _table;
+            u8* _indices;
+            int _parts;
+        };
+
+        void find_nearest_parallel(const RGB* colors, int count, const NearestTable& table, u8* indices)
+        {
+            int parts = count / MIN_PART_SIZE;
+            if (parts > GetWorkerCount()) {
+                parts = GetWorkerCount();
+            }
+            if (parts < 1) {
+                parts = 1;
+            }
+
+            FindNearestTask task(colors, count, table, indices, parts);
+            RunParallel(task, parts);
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    KMeansQuantContext::KMeansQuantContext(int iterations)
+        : _iterations(iterations)
+        , _paletteSize(0)
+    {
+    }
+
+    //--------------------------------------------------------------
+    KMeansQuantContext::~KMeansQuantContext()
+    {
+    }
+
+    //--------------------------------------------------------------
+    void
+    KMeansQuantContext::reset()
+    {
+        _octree.reset();
+        _paletteSize = 0;
+    }
+
+    //--------------------------------------------------------------
+    void
+    KMeansQuantContext::addPixels(const RGB* pixels, int count)
+    {
+        _octree.addPixels(pixels, count);
+    }
+
+    //--------------------------------------------------------------
+    void
+    KMeansQuantContext::merge(const Quantizer& other)
+    {
+        _octree.merge(((const KMeansQuantContext&)other)._octree);
+    }
+
+    //--------------------------------------------------------------
+    int
+    KMeansQuantContext::buildPalette(RGB palette[256])
+    {
+        _paletteSize = _octree.buildPalette(palette);
+
+        if (_paletteSize == 0) {
+            return 0;
+        }
+
+        const ColorHistogram& histogram = _octree.getHistogram();
+        const ColorCell* slots = histogram.getSlots();
+        int capacity = histogram.getCapacity();
+        int cells_count = histogram.getCellCount();
+
+        // every cell takes part with its mean color and its weight
+        ArrayAutoPtr<int> cells = new int[cells_count];
+        ArrayAutoPtr<RGB> colors = new RGB[cells_count];
+        int n = 0;
+
+        for (int i = 0; i < capacity; i++) {
+            const ColorCell& cell = slots[i];
+
+            if (cell.key != ColorHistogram::EmptyKey) {
+                cells[n] = i;
+                colors[n].red   = (u8)((GetCellSum(cell, 0) + cell.count / 2) / cell.count);
+                colors[n].green = (u8)((GetCellSum(cell, 1) + cell.count / 2) / cell.count);
+                colors[n].blue  = (u8)((GetCellSum(cell, 2) + cell.count / 2) / cell.count);
+                n++;
+            }
+        }
+
+        ArrayAutoPtr<u8> assignment = new u8[cells_count];
+        ArrayAutoPtr<u8> previous = new u8[cells_count];
+
+        for (int iteration = 0; iteration < _iterations; iteration++) {
+            BuildNearestTable(palette, _paletteSize, _table);
+            find_nearest_parallel(colors.get(), cells_count, _table, assignment.get());
+
+            if (iteration > 0 && std::memcmp(assignment.get(), previous.get(), cells_count) == 0) {
+                // converged, the centroids won't move anymore
+                break;
+            }
+
+            // the sums are exact integers, so the result doesn't
+            // depend on the order in which the cells are visited
+            u64 sums[256][3];
+            u64 counts[256];
+            std::memset(sums, 0, sizeof(sums));
+            std::memset(counts, 0, sizeof(counts));
+
+            for (int i = 0; i < cells_count; i++) {
+                const ColorCell& cell = slots[cells[i]];
+                int k = assignment[i];
+
+                sums[k][0] += GetCellSum(cell, 0);
+                sums[k][1] += GetCellSum(cell, 1);
+                sums[k][2] += GetCellSum(cell, 2);
+                counts[k] += cell.count;
+            }
+
+            for (int k = 0; k < _paletteSize; k++) {
+                // an entry that lost all its colors keeps its position
+                if (counts[k] != 0) {
+                    palette[k].red   = (u8)((sums[k][0] + counts[k] / 2) / counts[k]);
+                    palette[k].green = (u8)((sums[k][1] + counts[k] / 2) / counts[k]);
+                    palette[k].blue  = (u8)((sums[k][2] + counts[k] / 2) / counts[k]);
+                }
+            }
+
+            std::memcpy(previous.get(), assignment.get(), cells_count);
+        }
+
+        // resolve the palette index of every cell for the final palette
+        BuildNearestTable(palette, _paletteSize, _table);
+        find_nearest_parallel(colors.get(), cells_count, _table, assignment.get());
+
+        _cellIndices.clear(cells_count);
+
+        for (int i = 0; i < cells_count; i++) {
+            _cellIndices.set(slots[cells[i]].key, assignment[i]);
+        }
+
+        return _paletteSize;
+    }
+
+    //--------------------------------------------------------------
+    void
+    KMeansQuantContext::mapPixels(const RGB* pixels, int count, u8* indices)
+    {
+        if (_paletteSize == 0) {
+            // no palette has been built
+            std::memset(indices, 0, count);
+            return;
+        }
+
+        FindNearestFunc find_nearest = GetKernels().findNearest;
+        NearestCache cache;
+
+        u32 last_key = ColorHistogram::EmptyKey;
+        u8 last_index = 0;
+
+        for (int i = 0; i < count; i++) {
+            u32 key = GetCellKey(pixels[i]);
+
+            if (key != last_key) {
+                u16 index = _cellIndices.get(key);
+
+                if (index == CellIndexTable::Unresolved) {
+                    // a cell that was never added, match its center; the
+                    // cell table is shared by all mapping threads, so the
+                    // result only goes into the local cache
+                    u8 nearest;
+                    if (!cache.find(key, nearest)) {
+                        RGB center = GetCellCenter(key);
+                        find_nearest(&center, 1, _table, &nearest);
+                        cache.set(key, nearest);
+                    }
+                    index = nearest;
+                }
+
+                last_key = key;
+                last_index = (u8)index;
+            }
+
+            indices[i] = last_index;
+        }
+    }
+
+}
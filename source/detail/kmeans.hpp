@@ -0,0 +1,67 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_KMEANS_HPP_INCLUDED
+#define AZURA_KMEANS_HPP_INCLUDED
+
+#include "../types.hpp"
+#include "../color.hpp"
+#include "colormatch.hpp"
+#include "octreequant.hpp"
+#include "quantize.hpp"
+
+
+namespace azura {
+
+    // refines the octree palette with k-means (Lloyd's algorithm) over
+    // the color cells of the histogram and maps every color to its
+    // nearest palette entry
+    class KMeansQuantContext : public Quantizer {
+    public:
+        explicit KMeansQuantContext(int iterations);
+        ~KMeansQuantContext();
+
+        void reset();
+        void addPixels(const RGB* pixels, int count);
+        void merge(const Quantizer& other);
+        int buildPalette(RGB palette[256]);
+        void mapPixels(const RGB* pixels, int count, u8* indices);
+
+    private:
+        KMeansQuantContext(const KMeansQuantContext&);
+        KMeansQuantContext& operator=(const KMeansQuantContext&);
+
+    private:
+        OctreeQuantContext _octree; /* seeds the palette, owns the histogram */
+        int _iterations;
+
+        NearestTable _table;
+        int _paletteSize;
+
+        CellIndexTable _cellIndices;
+    };
+
+}
+
+
+#endif
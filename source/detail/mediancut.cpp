@@ -0,0 +1,363 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include <cstring>
+
+#include "ArrayAutoPtr.hpp"
+#include "kernels.hpp"
+#include "mediancut.hpp"
+
+#define BUCKET_BITS  5
+#define BUCKET_SHIFT (8 - BUCKET_BITS)
+#define BUCKET_SIZE  (1 << BUCKET_BITS)
+#define BUCKET_COUNT (1 << (3 * BUCKET_BITS))
+#define UNRESOLVED   0xFFFF
+
+
+namespace azura {
+
+    struct mc_bucket {
+        u32 count;
+        u32 low[3]; /* sums of the dropped low bits, keeping the means exact */
+    };
+
+    struct mc_box {
+        int lo[3];
+        int hi[3]; /* inclusive bucket coordinates */
+        u32 count;
+    };
+
+    namespace {
+
+        inline int bucket_index(int r, int g, int b)
+        {
+            return (r << (2 * BUCKET_BITS)) | (g << BUCKET_BITS) | b;
+        }
+
+        inline int bucket_index(const RGB& c)
+        {
+            return bucket_index(c.red >> BUCKET_SHIFT, c.green >> BUCKET_SHIFT, c.blue >> BUCKET_SHIFT);
+        }
+
+        inline int longest_axis(const mc_box& box)
+        {
+            int axis = 0;
+
+            for (int c = 1; c < 3; c++) {
+                if (box.hi[c] - box.lo[c] > box.hi[axis] - box.lo[axis]) {
+                    axis = c;
+                }
+            }
+
+            return axis;
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    MedianCutContext::MedianCutContext()
+        : _buckets(0)
+        , _lut(0)
+        , _paletteSize(0)
+    {
+        _buckets = new mc_bucket[BUCKET_COUNT];
+        std::memset(_buckets, 0, BUCKET_COUNT * sizeof(mc_bucket));
+
+        _lut = new u16[BUCKET_COUNT];
+    }
+
+    //--------------------------------------------------------------
+    MedianCutContext::~MedianCutContext()
+    {
+        delete[] _buckets;
+        delete[] _lut;
+    }
+
+    //--------------------------------------------------------------
+    void
+    MedianCutContext::reset()
+    {
+        std::memset(_buckets, 0, BUCKET_COUNT * sizeof(mc_bucket));
+        _paletteSize = 0;
+    }
+
+    //--------------------------------------------------------------
+    void
+    MedianCutContext::addPixels(const RGB* pixels, int count)
+    {
+        const u32 low_mask = (1 << BUCKET_SHIFT) - 1;
+
+        for (int i = 0; i < count; i++) {
+            mc_bucket* bucket = _buckets + bucket_index(pixels[i]);
+
+            bucket->count++;
+            bucket->low[0] += pixels[i].red   & low_mask;
+            bucket->low[1] += pixels[i].green & low_mask;
+            bucket->low[2] += pixels[i].blue  & low_mask;
+        }
+    }
+
+    //--------------------------------------------------------------
+    void
+    MedianCutContext::merge(const Quantizer& other)
+    {
+        const mc_bucket* buckets = ((const MedianCutContext&)other)._buckets;
+
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            _buckets[i].count  += buckets[i].count;
+            _buckets[i].low[0] += buckets[i].low[0];
+            _buckets[i].low[1] += buckets[i].low[1];
+            _buckets[i].low[2] += buckets[i].low[2];
+        }
+    }
+
+    //--------------------------------------------------------------
+    void
+    MedianCutContext::shrinkBox(mc_box& box) const
+    {
+        int lo[3] = { BUCKET_SIZE, BUCKET_SIZE, BUCKET_SIZE };
+        int hi[3] = { -1, -1, -1 };
+        u32 count = 0;
+
+        for (int r = box.lo[0]; r <= box.hi[0]; r++) {
+            for (int g = box.lo[1]; g <= box.hi[1]; g++) {
+                for (int b = box.lo[2]; b <= box.hi[2]; b++) {
+                    u32 n = _buckets[bucket_index(r, g, b)].count;
+
+                    if (n != 0) {
+                        int coords[3] = { r, g, b };
+
+                        for (int c = 0; c < 3; c++) {
+                            if (coords[c] < lo[c]) { lo[c] = coords[c]; }
+                            if (coords[c] > hi[c]) { hi[c] = coords[c]; }
+                        }
+
+                        count += n;
+                    }
+                }
+            }
+        }
+
+        for (int c = 0; c < 3; c++) {
+            box.lo[c] = lo[c];
+            box.hi[c] = hi[c];
+        }
+
+        box.count = count;
+    }
+
+    //--------------------------------------------------------------
+    void
+    MedianCutContext::splitBox(mc_box& box, mc_box& other) const
+    {
+        int axis = longest_axis(box);
+
+        // project the population onto the axis
+        u32 projection[BUCKET_SIZE];
+        std::memset(projection, 0, sizeof(projection));
+
+        for (int r = box.lo[0]; r <= box.hi[0]; r++) {
+            for (int g = box.lo[1]; g <= box.hi[1]; g++) {
+                for (int b = box.lo[2]; b <= box.hi[2]; b++) {
+                    int coords[3] = { r, g, b };
+                    projection[coords[axis]] += _buckets[bucket_index(r, g, b)].count;
+                }
+            }
+        }
+
+        // split at the median, leaving at least one slice on either side;
+        // since the box is tight, both halves end up populated
+        int split = box.lo[axis];
+        u64 sum = projection[split];
+
+        while (split < box.hi[axis] - 1 && sum * 2 < box.count) {
+            split++;
+            sum += projection[split];
+        }
+
+        other = box;
+        box.hi[axis] = split;
+        other.lo[axis] = split + 1;
+
+        shrinkBox(box);
+        shrinkBox(other);
+    }
+
+    //--------------------------------------------------------------
+    RGB
+    MedianCutContext::getBucketColor(int index) const
+    {
+        const mc_bucket& bucket = _buckets[index];
+
+        int coords[3] = {
+            (index >> (2 * BUCKET_BITS)) & (BUCKET_SIZE - 1),
+            (index >> BUCKET_BITS) & (BUCKET_SIZE - 1),
+            index & (BUCKET_SIZE - 1),
+        };
+
+        u8 channels[3];
+
+        for (int c = 0; c < 3; c++) {
+            if (bucket.count != 0) {
+                // the mean of the colors in the bucket
+                u32 base = coords[c] << BUCKET_SHIFT;
+                channels[c] = (u8)(base + (bucket.low[c] + bucket.count / 2) / bucket.count);
+            } else {
+                // the center of the bucket
+                channels[c] = (u8)((coords[c] << BUCKET_SHIFT) + (1 << (BUCKET_SHIFT - 1)));
+            }
+        }
+
+        RGB col = { channels[0], channels[1], channels[2] };
+        return col;
+    }
+
+    //--------------------------------------------------------------
+    int
+    MedianCutContext::buildPalette(RGB palette[256])
+    {
+        mc_box boxes[256];
+        int boxes_count = 1;
+
+        for (int c = 0; c < 3; c++) {
+            boxes[0].lo[c] = 0;
+            boxes[0].hi[c] = BUCKET_SIZE - 1;
+        }
+
+        shrinkBox(boxes[0]);
+
+        if (boxes[0].count == 0) {
+            _paletteSize = 0;
+            return 0;
+        }
+
+        // keep splitting the box with the largest population times
+        // extent until the palette is full or no box can be split
+        while (boxes_count < 256) {
+            int best = -1;
+            u64 best_score = 0;
+
+            for (int i = 0; i < boxes_count; i++) {
+                int extent = boxes[i].hi[longest_axis(boxes[i])] - boxes[i].lo[longest_axis(boxes[i])];
+                u64 score = (u64)boxes[i].count * extent;
+
+                if (score > best_score) {
+                    best = i;
+                    best_score = score;
+                }
+            }
+
+            if (best < 0) {
+                break;
+            }
+
+            splitBox(boxes[best], boxes[boxes_count]);
+            boxes_count++;
+        }
+
+        // each palette entry is the mean of the colors in its box
+        for (int i = 0; i < boxes_count; i++) {
+            const mc_box& box = boxes[i];
+            u64 sums[3] = { 0, 0, 0 };
+
+            for (int r = box.lo[0]; r <= box.hi[0]; r++) {
+                for (int g = box.lo[1]; g <= box.hi[1]; g++) {
+                    for (int b = box.lo[2]; b <= box.hi[2]; b++) {
+                        const mc_bucket& bucket = _buckets[bucket_index(r, g, b)];
+                        int coords[3] = { r, g, b };
+
+                        for (int c = 0; c < 3; c++) {
+                            sums[c] += (u64)bucket.count * (coords[c] << BUCKET_SHIFT) + bucket.low[c];
+                        }
+                    }
+                }
+            }
+
+            palette[i].red   = (u8)((sums[0] + box.count / 2) / box.count);
+            palette[i].green = (u8)((sums[1] + box.count / 2) / box.count);
+            palette[i].blue  = (u8)((sums[2] + box.count / 2) / box.count);
+        }
+
+        _paletteSize = boxes_count;
+        BuildNearestTable(palette, _paletteSize, _table);
+
+        // map the populated buckets to their nearest palette entry in one
+        // batch, the others are matched when mapping
+        std::memset(_lut, 0xFF, BUCKET_COUNT * sizeof(u16));
+
+        ArrayAutoPtr<int> keys = new int[BUCKET_COUNT];
+        ArrayAutoPtr<RGB> colors = new RGB[BUCKET_COUNT];
+        ArrayAutoPtr<u8> nearest = new u8[BUCKET_COUNT];
+        int keys_count = 0;
+
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            if (_buckets[i].count != 0) {
+                keys[keys_count] = i;
+                colors[keys_count] = getBucketColor(i);
+                keys_count++;
+            }
+        }
+
+        GetKernels().findNearest(colors.get(), keys_count, _table, nearest.get());
+
+        for (int i = 0; i < keys_count; i++) {
+            _lut[keys[i]] = nearest[i];
+        }
+
+        return _paletteSize;
+    }
+
+    //--------------------------------------------------------------
+    void
+    MedianCutContext::mapPixels(const RGB* pixels, int count, u8* indices)
+    {
+        if (_paletteSize == 0) {
+            // no palette has been built
+            std::memset(indices, 0, count);
+            return;
+        }
+
+        FindNearestFunc find_nearest = GetKernels().findNearest;
+        NearestCache cache;
+
+        for (int i = 0; i < count; i++) {
+            int key = bucket_index(pixels[i]);
+            u16 index = _lut[key];
+
+            if (index == UNRESOLVED) {
+                // an empty bucket; the lookup table is shared by all mapping
+                // threads, so the result only goes into the local cache
+                u8 nearest;
+                if (!cache.find(key, nearest)) {
+                    RGB col = getBucketColor(key);
+                    find_nearest(&col, 1, _table, &nearest);
+                    cache.set(key, nearest);
+                }
+                index = nearest;
+            }
+
+            indices[i] = (u8)index;
+        }
+    }
+
+}
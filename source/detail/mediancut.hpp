@@ -0,0 +1,69 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_MEDIANCUT_HPP_INCLUDED
+#define AZURA_MEDIANCUT_HPP_INCLUDED
+
+#include "../types.hpp"
+#include "../color.hpp"
+#include "colormatch.hpp"
+#include "quantize.hpp"
+
+
+namespace azura {
+
+    struct mc_bucket;
+    struct mc_box;
+
+    // median cut over a fixed grid of 5 bit per channel color buckets;
+    // trades some palette quality for a very cheap histogram and mapping
+    class MedianCutContext : public Quantizer {
+    public:
+        MedianCutContext();
+        ~MedianCutContext();
+
+        void reset();
+        void addPixels(const RGB* pixels, int count);
+        void merge(const Quantizer& other);
+        int buildPalette(RGB palette[256]);
+        void mapPixels(const RGB* pixels, int count, u8* indices);
+
+    private:
+        MedianCutContext(const MedianCutContext&);
+        MedianCutContext& operator=(const MedianCutContext&);
+
+        void shrinkBox(mc_box& box) const;
+        void splitBox(mc_box& box, mc_box& other) const;
+        RGB getBucketColor(int index) const;
+
+    private:
+        mc_bucket* _buckets;
+        u16* _lut; /* palette index for each bucket */
+        NearestTable _table;
+        int _paletteSize;
+    };
+
+}
+
+
+#endif
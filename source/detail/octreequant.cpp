@@ -22,274 +22,411 @@
     THE SOFTWARE.
 */
 
-// This module uses parts from http://rosettacode.org/wiki/Color_quantization/C
-// TODO: Rewrite and drop those parts, because of possible incompatibilities with the GFDL.
+// The order in which nodes are folded follows the octree quantizer
+// from http://rosettacode.org/wiki/Color_quantization/C
 
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
-#include <cmath>
 
-#define ON_INHEAP   1
-
-#include "../types.hpp"
+#include "ArrayAutoPtr.hpp"
+#include "kernels.hpp"
 #include "octreequant.hpp"
 
+#define TREE_DEPTH 7 /* leaves are the color cells of the histogram */
+#define NO_CHILD   0 /* the root is never a child, so id 0 is free */
+
 
 namespace azura {
 
     struct oct_node {
-        u32 r;
-        u32 g;
-        u32 b; /* sum of all child node colors */
+        u64 r;
+        u64 g;
+        u64 b; /* sum of all colors in this node */
         u32 count;
-        u32 heap_idx;
-        u32 children_count;
-        u32 child_idx;
-        u32 flags;
-        u32 depth;
-        oct_node* parent;
-        oct_node* children[8];
+        u32 parent;
+        u32 heap_idx; /* 0 if not in the heap */
+        u8  children_count;
+        u8  child_idx;
+        u8  depth;
+        u8  padding;
+        u32 children[8];
     };
 
-    struct node_heap {
-        int alloc;
-        int n;
-        oct_node** buf;
-    };
+    namespace {
+
+        inline int child_index(u32 key, int depth)
+        {
+            int bit = TREE_DEPTH - depth;
+            int r = (key >> (14 + bit)) & 1;
+            int g = (key >> ( 7 + bit)) & 1;
+            int b = (key >> bit) & 1;
+            return g * 4 + r * 2 + b;
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    OctreeQuantContext::OctreeQuantContext()
+        : _nodes(0)
+        , _nodesCount(0)
+        , _nodesAlloc(0)
+        , _heap(0)
+        , _heapCount(0)
+        , _heapAlloc(0)
+    {
+    }
 
-    inline int cmp_node(oct_node* a, oct_node* b)
+    //--------------------------------------------------------------
+    OctreeQuantContext::~OctreeQuantContext()
     {
-        if (a->children_count < b->children_count) {
-            return -1;
+        free(_nodes);
+        free(_heap);
+    }
+
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::reset()
+    {
+        // keep the allocated memory for the next run
+        _histogram.clear();
+        _nodesCount = 0;
+        _heapCount = 0;
+    }
+
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::addPixels(const RGB* pixels, int count)
+    {
+        _histogram.addPixels(pixels, count);
+    }
+
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::merge(const Quantizer& other)
+    {
+        _histogram.merge(((const OctreeQuantContext&)other)._histogram);
+    }
+
+    //--------------------------------------------------------------
+    const ColorHistogram&
+    OctreeQuantContext::getHistogram() const
+    {
+        return _histogram;
+    }
+
+    //--------------------------------------------------------------
+    u32
+    OctreeQuantContext::newNode(u8 idx, u8 depth, u32 parent)
+    {
+        if (_nodesCount >= _nodesAlloc) {
+            _nodesAlloc = (_nodesAlloc ? _nodesAlloc * 2 : 4096);
+            _nodes = (oct_node*)realloc(_nodes, sizeof(oct_node) * _nodesAlloc);
         }
 
-        if (a->children_count > b->children_count) {
-            return 1;
+        u32 id = _nodesCount++;
+        oct_node* x = _nodes + id;
+        std::memset(x, 0, sizeof(oct_node));
+
+        x->child_idx = idx;
+        x->depth = depth;
+        x->parent = parent;
+
+        if (id != 0) {
+            _nodes[parent].children_count++;
+        }
+
+        return id;
+    }
+
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::insertCell(const ColorCell& cell)
+    {
+        u32 node = 0;
+
+        for (int depth = 1; depth <= TREE_DEPTH; depth++) {
+            int i = child_index(cell.key, depth);
+            u32 child = _nodes[node].children[i];
+
+            if (child == NO_CHILD) {
+                child = newNode(i, depth, node);
+                _nodes[node].children[i] = child;
+            }
+
+            node = child;
         }
 
-        int ac = a->count >> a->depth;
-        int bc = b->count >> b->depth;
+        oct_node* leaf = _nodes + node;
+        leaf->r = GetCellSum(cell, 0);
+        leaf->g = GetCellSum(cell, 1);
+        leaf->b = GetCellSum(cell, 2);
+        leaf->count = cell.count;
+    }
 
-        return ac < bc ? -1 : ac > bc;
+    //--------------------------------------------------------------
+    bool
+    OctreeQuantContext::lessThan(u32 a, u32 b) const
+    {
+        const oct_node* na = _nodes + a;
+        const oct_node* nb = _nodes + b;
+
+        if (na->children_count != nb->children_count) {
+            return na->children_count < nb->children_count;
+        }
+
+        return (na->count >> na->depth) < (nb->count >> nb->depth);
     }
 
-    void down_heap(node_heap* h, oct_node* p)
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::heapDown(u32 n)
     {
-        int n = p->heap_idx;
-        int m;
+        u32 p = _heap[n];
 
         while (true) {
-            m = n * 2;
+            u32 m = n * 2;
 
-            if (m >= h->n) {
+            if ((int)m >= _heapCount) {
                 break;
             }
 
-            if (m + 1 < h->n && cmp_node(h->buf[m], h->buf[m + 1]) > 0) {
+            if ((int)m + 1 < _heapCount && lessThan(_heap[m + 1], _heap[m])) {
                 m++;
             }
 
-            if (cmp_node(p, h->buf[m]) <= 0) {
+            if (!lessThan(_heap[m], p)) {
                 break;
             }
 
-            h->buf[n] = h->buf[m];
-            h->buf[n]->heap_idx = n;
+            _heap[n] = _heap[m];
+            _nodes[_heap[n]].heap_idx = n;
             n = m;
         }
 
-        h->buf[n] = p;
-        p->heap_idx = n;
+        _heap[n] = p;
+        _nodes[p].heap_idx = n;
     }
 
-    void up_heap(node_heap* h, oct_node* p)
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::heapUp(u32 n)
     {
-        int n = p->heap_idx;
-        oct_node* prev;
+        u32 p = _heap[n];
 
         while (n > 1) {
-            prev = h->buf[n / 2];
+            u32 prev = _heap[n / 2];
 
-            if (cmp_node(p, prev) >= 0) {
+            if (!lessThan(p, prev)) {
                 break;
             }
 
-            h->buf[n] = prev;
-            prev->heap_idx = n;
+            _heap[n] = prev;
+            _nodes[prev].heap_idx = n;
             n /= 2;
         }
 
-        h->buf[n] = p;
-        p->heap_idx = n;
+        _heap[n] = p;
+        _nodes[p].heap_idx = n;
     }
 
-    void heap_add(node_heap *h, oct_node* p)
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::heapAdd(u32 node)
     {
-        if ((p->flags & ON_INHEAP)) {
-            down_heap(h, p);
-            up_heap(h, p);
-            return;
-        }
+        u32 idx = _nodes[node].heap_idx;
 
-        p->flags |= ON_INHEAP;
-
-        if (!h->n) {
-            h->n = 1;
-        }
-
-        if (h->n >= h->alloc) {
-            while (h->n >= h->alloc) h->alloc += 1024;
-            h->buf = (oct_node**)realloc(h->buf, sizeof(oct_node*) * h->alloc);
+        if (idx != 0) {
+            // already in the heap, just restore the heap order
+            heapDown(idx);
+            heapUp(_nodes[node].heap_idx);
+            return;
         }
 
-        p->heap_idx = h->n;
-        h->buf[h->n++] = p;
-        up_heap(h, p);
+        idx = _heapCount++;
+        _heap[idx] = node;
+        _nodes[node].heap_idx = idx;
+        heapUp(idx);
     }
 
-    oct_node* pop_heap(node_heap *h)
+    //--------------------------------------------------------------
+    u32
+    OctreeQuantContext::heapPop()
     {
-        if (h->n <= 1) {
-            return 0;
-        }
+        assert(_heapCount > 1);
 
-        oct_node* ret = h->buf[1];
-        h->buf[1] = h->buf[--h->n];
+        u32 ret = _heap[1];
+        _nodes[ret].heap_idx = 0;
 
-        h->buf[h->n] = 0;
-
-        h->buf[1]->heap_idx = 1;
-        down_heap(h, h->buf[1]);
+        _heapCount--;
+        if (_heapCount > 1) {
+            _heap[1] = _heap[_heapCount];
+            heapDown(1);
+        }
 
         return ret;
     }
 
-    static oct_node* pool = 0;
-    static int len = 0;
-    oct_node* node_new(u8 idx, u8 depth, oct_node* p)
+    //--------------------------------------------------------------
+    int
+    OctreeQuantContext::buildPalette(RGB palette[256])
     {
-        if (len <= 1) {
-            oct_node* p = (oct_node*)calloc(sizeof(oct_node), 2048);
-            p->parent = pool;
-            pool = p;
-            len = 2047;
-        }
+        int cells_count = _histogram.getCellCount();
 
-        oct_node* x = pool + len--;
+        // build the tree from the color cells, in ascending order so
+        // that the outcome doesn't depend on the hash table layout
+        _nodesCount = 0;
+        newNode(0, 0, 0);
 
-        x->child_idx = idx;
-        x->depth = depth;
-        x->parent = p;
+        if (cells_count > 0) {
+            ArrayAutoPtr<ColorCell> cells = new ColorCell[cells_count];
+            _histogram.getSortedCells(cells.get());
 
-        if (p) {
-            p->children_count++;
+            for (int i = 0; i < cells_count; i++) {
+                insertCell(cells[i]);
+            }
         }
 
-        return x;
-    }
+        // every node might end up in the heap (slot 0 is unused)
+        if (_heapAlloc < _nodesCount + 1) {
+            _heapAlloc = _nodesCount + 1;
+            _heap = (u32*)realloc(_heap, sizeof(u32) * _heapAlloc);
+        }
 
-    void node_free()
-    {
-        oct_node* p;
-        while (pool) {
-            p = pool->parent;
-            free(pool);
-            pool = p;
+        // put all leaves into the heap at once, then establish the heap order
+        _heapCount = 1;
+        for (int i = 0; i < _nodesCount; i++) {
+            if (_nodes[i].children_count == 0 && _nodes[i].depth == TREE_DEPTH) {
+                _heap[_heapCount] = i;
+                _nodes[i].heap_idx = _heapCount;
+                _heapCount++;
+            }
         }
 
-        len = 0;
-    }
+        for (int i = (_heapCount - 1) / 2; i >= 1; i--) {
+            heapDown(i);
+        }
 
-    oct_node* node_insert(oct_node* root, u8 *pix)
-    {
-        u8 depth = 0;
-        for (u8 bit = 1 << 7; ++depth < 8; bit >>= 1) {
-            u8 i = !!(pix[1] & bit) * 4 + !!(pix[0] & bit) * 2 + !!(pix[2] & bit);
-            if (!root->children[i]) {
-                root->children[i] = node_new(i, depth, root);
-            }
-            root = root->children[i];
+        // fold the least important nodes into their parents
+        // until the remaining nodes fit into the palette
+        while (_heapCount > 256 /* palette size */ + 1) {
+            oct_node* p = _nodes + heapPop();
+            oct_node* q = _nodes + p->parent;
+
+            q->count += p->count;
+            q->r += p->r;
+            q->g += p->g;
+            q->b += p->b;
+
+            q->children_count--;
+            q->children[p->child_idx] = NO_CHILD;
+
+            heapAdd(p->parent);
         }
 
-        root->r += pix[0];
-        root->g += pix[1];
-        root->b += pix[2];
-        root->count++;
+        for (int i = 1; i < _heapCount; i++) {
+            oct_node* node = _nodes + _heap[i];
 
-        return root;
-    }
+            double c = node->count;
 
-    oct_node* node_fold(oct_node* p)
-    {
-        assert(p->children_count == 0);
+            RGB* plt_entry = palette + (i - 1);
 
-        oct_node* q = p->parent;
+            plt_entry->red   = (u8)(node->r / c + .5);
+            plt_entry->green = (u8)(node->g / c + .5);
+            plt_entry->blue  = (u8)(node->b / c + .5);
+        }
 
-        q->count += p->count;
+        if (_heapCount == 1) {
+            // no pixels have been added
+            return 0;
+        }
 
-        q->r += p->r;
-        q->g += p->g;
-        q->b += p->b;
+        // resolve the palette index of every color cell up front, so
+        // that mapping a pixel is a single table lookup; cells that were
+        // never added are matched against the palette when mapping
+        BuildNearestTable(palette, _heapCount - 1, _table);
+        _cellIndices.clear(_histogram.getCellCount());
 
-        q->children_count --;
-        q->children[p->child_idx] = 0;
+        int capacity = _histogram.getCapacity();
+        const ColorCell* slots = _histogram.getSlots();
 
-        return q;
+        for (int i = 0; i < capacity; i++) {
+            if (slots[i].key != ColorHistogram::EmptyKey) {
+                _cellIndices.set(slots[i].key, findPaletteIndex(slots[i].key));
+            }
+        }
+
+        return _heapCount - 1;
     }
 
-    void color_replace(oct_node* root, u8* src, u8* dst)
+    //--------------------------------------------------------------
+    u8
+    OctreeQuantContext::findPaletteIndex(u32 key) const
     {
-        for (u8 bit = 1 << 7; bit; bit >>= 1) {
-            u8 i = !!(src[1] & bit) * 4 + !!(src[0] & bit) * 2 + !!(src[2] & bit);
-            if (!root->children[i]) break;
-            root = root->children[i];
+        u32 node = 0;
+
+        for (int depth = 1; depth <= TREE_DEPTH; depth++) {
+            u32 child = _nodes[node].children[child_index(key, depth)];
+            if (child == NO_CHILD) {
+                break;
+            }
+            node = child;
+        }
+
+        // the walk ends on the leaf of the cell or on the node it was
+        // folded into, both of which have a palette entry; this only
+        // guards against keys that were never added
+        while (_nodes[node].heap_idx == 0) {
+            int i = 0;
+            while (_nodes[node].children[i] == NO_CHILD) {
+                i++;
+            }
+            node = _nodes[node].children[i];
         }
 
-        *dst = root->heap_idx - 1;
+        return (u8)(_nodes[node].heap_idx - 1);
     }
 
-    void OctreeQuant(RGB* src_pixels, int pixels_count, u8* dst_pixels, RGB dst_palette[256])
+    //--------------------------------------------------------------
+    void
+    OctreeQuantContext::mapPixels(const RGB* pixels, int count, u8* indices)
     {
-        node_heap heap = { 0, 0, 0 };
-        oct_node* root = node_new(0, 0, 0);
-
-        RGB* pix = src_pixels;
-        for (int i = 0; i < pixels_count; i++) {
-            heap_add(&heap, node_insert(root, (u8*)pix));
-            pix++;
+        if (_heapCount <= 1) {
+            // no palette has been built
+            std::memset(indices, 0, count);
+            return;
         }
 
-        while (heap.n > 256 /* palette size */ + 1) {
-            heap_add(&heap, node_fold(pop_heap(&heap)));
-        }
+        FindNearestFunc find_nearest = GetKernels().findNearest;
+        NearestCache cache;
 
-        for (int i = 1; i < heap.n; i++) {
-            oct_node* node = heap.buf[i];
+        u32 last_key = ColorHistogram::EmptyKey;
+        u8 last_index = 0;
 
-            double c = node->count;
+        for (int i = 0; i < count; i++) {
+            u32 key = GetCellKey(pixels[i]);
 
-            node->r = (u32)(node->r / c + .5);
-            node->g = (u32)(node->g / c + .5);
-            node->b = (u32)(node->b / c + .5);
+            if (key != last_key) {
+                u16 index = _cellIndices.get(key);
 
-            RGB* plt_entry = dst_palette + (i - 1);
+                if (index == CellIndexTable::Unresolved) {
+                    // a cell the sampling skipped or an image that wasn't
+                    // added; the tree could only guess, so match its center
+                    u8 nearest;
+                    if (!cache.find(key, nearest)) {
+                        RGB center = GetCellCenter(key);
+                        find_nearest(&center, 1, _table, &nearest);
+                        cache.set(key, nearest);
+                    }
+                    index = nearest;
+                }
 
-            plt_entry->red   = node->r;
-            plt_entry->green = node->g;
-            plt_entry->blue  = node->b;
-        }
+                last_key = key;
+                last_index = (u8)index;
+            }
 
-        RGB* sptr = src_pixels;
-        u8* dptr = dst_pixels;
-        for (int i = 0; i < pixels_count; i++) {
-            color_replace(root, (u8*)sptr, dptr);
-            sptr++;
-            dptr++;
+            indices[i] = last_index;
         }
-
-        node_free();
-        free(heap.buf);
     }
 
 }
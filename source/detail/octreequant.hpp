@@ -27,11 +27,60 @@
 
 #include "../types.hpp"
 #include "../color.hpp"
+#include "colormatch.hpp"
+#include "histogram.hpp"
+#include "quantize.hpp"
 
 
 namespace azura {
 
-    void OctreeQuant(RGB* src_pixels, int pixels_count, u8* dst_pixels, RGB dst_palette[256]);
+    struct oct_node;
+
+    // holds all state of a quantization run, so that concurrent runs
+    // don't interfere; a context may be reused to avoid reallocating
+    // its buffers, but it must not be shared between threads
+    class OctreeQuantContext : public Quantizer {
+    public:
+        OctreeQuantContext();
+        ~OctreeQuantContext();
+
+        void reset();
+        void addPixels(const RGB* pixels, int count);
+        void merge(const Quantizer& other);
+        int buildPalette(RGB palette[256]);
+        void mapPixels(const RGB* pixels, int count, u8* indices);
+
+        // the colors accumulated so far
+        const ColorHistogram& getHistogram() const;
+
+    private:
+        OctreeQuantContext(const OctreeQuantContext&);
+        OctreeQuantContext& operator=(const OctreeQuantContext&);
+
+        u32 newNode(u8 idx, u8 depth, u32 parent);
+        void insertCell(const ColorCell& cell);
+        u8 findPaletteIndex(u32 key) const;
+
+        bool lessThan(u32 a, u32 b) const;
+        void heapDown(u32 n);
+        void heapUp(u32 n);
+        void heapAdd(u32 node);
+        u32 heapPop();
+
+    private:
+        ColorHistogram _histogram;
+
+        oct_node* _nodes;
+        int _nodesCount;
+        int _nodesAlloc;
+
+        u32* _heap;
+        int _heapCount;
+        int _heapAlloc;
+
+        CellIndexTable _cellIndices;
+        NearestTable _table;
+    };
 
 }
 
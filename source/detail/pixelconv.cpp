@@ -0,0 +1,327 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <cassert>
+#include <cstring>
+
+#include "pixelconv.hpp"
+
+#if defined(AZURA_X86)
+#    include <immintrin.h>
+#endif
+
+
+namespace azura {
+
+    //--------------------------------------------------------------
+    void SetupBitfieldsLayout(BitfieldsLayout& layout, u32 red_mask, u32 green_mask, u32 blue_mask, u32 alpha_mask)
+    {
+        u32 masks[4] = { blue_mask, green_mask, red_mask, alpha_mask };
+
+        for (int c = 0; c < 4; c++) {
+            u32 mask  = masks[c];
+            u32 shift = 0;
+            u32 bits  = 0;
+
+            if (mask != 0) {
+                while (((mask >> shift) & 1) == 0) {
+                    shift++;
+                }
+                while (bits < 32 - shift && (mask >> (shift + bits)) != 0) {
+                    bits++;
+                }
+
+                // wider fields keep their most significant 8 bits
+                if (bits > 8) {
+                    shift += bits - 8;
+                    bits = 8;
+                }
+            }
+
+            layout.masks[c]  = mask;
+            layout.shifts[c] = shift;
+            layout.bits[c]   = bits;
+        }
+
+        layout.fill = (alpha_mask == 0 ? 0xFF000000 : 0);
+    }
+
+    //--------------------------------------------------------------
+    void SwizzlePixelsScalar(const u8* src, const PixelFormatDescriptor& spfd, u8* dst, const PixelFormatDescriptor& dpfd, int count)
+    {
+        for (int i = count; i > 0; i--) {
+            dst[dpfd.redMask]   = src[spfd.redMask];
+            dst[dpfd.greenMask] = src[spfd.greenMask];
+            dst[dpfd.blueMask]  = src[spfd.blueMask];
+
+            if (dpfd.hasAlpha) {
+                if (spfd.hasAlpha) {
+                    dst[dpfd.alphaMask] = src[spfd.alphaMask];
+                } else {
+                    dst[dpfd.alphaMask] = 255;
+                }
+            }
+
+            src += spfd.bytesPerPixel;
+            dst += dpfd.bytesPerPixel;
+        }
+    }
+
+    //--------------------------------------------------------------
+    void ExpandIndexedScalar(const u8* src, int count, const u8 table[256][4], int bpp, u8* dst)
+    {
+        if (bpp == 4) {
+            u32 table32[256];
+            std::memcpy(table32, table, sizeof(table32));
+
+            u32* dptr = (u32*)dst;
+
+            for (; count >= 4; count -= 4) {
+                dptr[0] = table32[src[0]];
+                dptr[1] = table32[src[1]];
+                dptr[2] = table32[src[2]];
+                dptr[3] = table32[src[3]];
+
+                src  += 4;
+                dptr += 4;
+            }
+
+            for (; count > 0; count--) {
+                *dptr++ = table32[*src++];
+            }
+        } else {
+            assert(bpp == 3);
+
+            for (; count > 0; count--) {
+                const u8* col = table[*src++];
+
+                dst[0] = col[0];
+                dst[1] = col[1];
+                dst[2] = col[2];
+
+                dst += 3;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------
+    void UnpackBitfieldsScalar(const u8* src, int sbpp, int count, const BitfieldsLayout& layout, u8* dst)
+    {
+        for (; count > 0; count--) {
+            u32 pixel = (sbpp == 2 ? (u32)src[0] | ((u32)src[1] << 8) : (u32)src[0] | ((u32)src[1] << 8) | ((u32)src[2] << 16) | ((u32)src[3] << 24));
+
+            for (int c = 0; c < 4; c++) {
+                // scale the field up to 8 bits by repeating its bits
+                u32 n = layout.bits[c];
+                u32 v = ((pixel & layout.masks[c]) >> layout.shifts[c]) << (8 - n);
+                for (u32 k = n; k > 0 && k < 8; k *= 2) {
+                    v |= v >> k;
+                }
+                dst[c] = (u8)v;
+            }
+
+            if (layout.fill) {
+                dst[3] = 255;
+            }
+
+            src += sbpp;
+            dst += 4;
+        }
+    }
+
+#if defined(AZURA_X86)
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("ssse3")
+    void SwizzlePixelsSSSE3(const u8* src, const PixelFormatDescriptor& spfd, u8* dst, const PixelFormatDescriptor& dpfd, int count)
+    {
+        int sbpp = spfd.bytesPerPixel;
+        int dbpp = dpfd.bytesPerPixel;
+
+        // number of pixels that fit into one 16 byte register on both sides
+        int n = (sbpp == 4 || dbpp == 4) ? 4 : 5;
+
+        // build the byte shuffle for n pixels; 0x80 clears a byte
+        u8 shuffle[16];
+        u8 alpha[16];
+        std::memset(shuffle, 0x80, sizeof(shuffle));
+        std::memset(alpha, 0x00, sizeof(alpha));
+
+        for (int p = 0; p < n; p++) {
+            shuffle[p * dbpp + dpfd.redMask]   = (u8)(p * sbpp + spfd.redMask);
+            shuffle[p * dbpp + dpfd.greenMask] = (u8)(p * sbpp + spfd.greenMask);
+            shuffle[p * dbpp + dpfd.blueMask]  = (u8)(p * sbpp + spfd.blueMask);
+
+            if (dpfd.hasAlpha) {
+                if (spfd.hasAlpha) {
+                    shuffle[p * dbpp + dpfd.alphaMask] = (u8)(p * sbpp + spfd.alphaMask);
+                } else {
+                    alpha[p * dbpp + dpfd.alphaMask] = 0xFF;
+                }
+            }
+        }
+
+        __m128i mask = _mm_loadu_si128((const __m128i*)shuffle);
+        __m128i amask = _mm_loadu_si128((const __m128i*)alpha);
+
+        // every step loads and stores a whole register, so stop while
+        // 16 bytes are still left on both sides; bytes written past the
+        // n converted pixels get overwritten by the following step
+        int min_bpp = (sbpp < dbpp ? sbpp : dbpp);
+        int min_count = (16 + min_bpp - 1) / min_bpp;
+
+        while (count >= min_count) {
+            __m128i v = _mm_loadu_si128((const __m128i*)src);
+            v = _mm_or_si128(_mm_shuffle_epi8(v, mask), amask);
+            _mm_storeu_si128((__m128i*)dst, v);
+
+            src += n * sbpp;
+            dst += n * dbpp;
+            count -= n;
+        }
+
+        SwizzlePixelsScalar(src, spfd, dst, dpfd, count);
+    }
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("avx2")
+    void ExpandIndexedAVX2(const u8* src, int count, const u8 table[256][4], int bpp, u8* dst)
+    {
+        if (bpp != 4) {
+            ExpandIndexedScalar(src, count, table, bpp, dst);
+            return;
+        }
+
+        const int* table32 = (const int*)table;
+
+        for (; count >= 8; count -= 8) {
+            __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+            __m256i v = _mm256_i32gather_epi32(table32, idx, 4);
+            _mm256_storeu_si256((__m256i*)dst, v);
+
+            src += 8;
+            dst += 32;
+        }
+
+        ExpandIndexedScalar(src, count, table, bpp, dst);
+    }
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("sse2")
+    void UnpackBitfieldsSSE2(const u8* src, int sbpp, int count, const BitfieldsLayout& layout, u8* dst)
+    {
+        __m128i masks[4], shifts[4], lshifts[4], n1[4], n2[4], n4[4];
+
+        for (int c = 0; c < 4; c++) {
+            u32 n = layout.bits[c];
+            masks[c]   = _mm_set1_epi32((int)layout.masks[c]);
+            shifts[c]  = _mm_cvtsi32_si128((int)layout.shifts[c]);
+            lshifts[c] = _mm_cvtsi32_si128((int)(8 - n + c * 8));
+            n1[c]      = _mm_cvtsi32_si128((int)n);
+            n2[c]      = _mm_cvtsi32_si128((int)n * 2);
+            n4[c]      = _mm_cvtsi32_si128((int)n * 4);
+        }
+
+        __m128i fill = _mm_set1_epi32((int)layout.fill);
+        __m128i zero = _mm_setzero_si128();
+
+        for (; count >= 4; count -= 4) {
+            __m128i pixels;
+            if (sbpp == 2) {
+                pixels = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)src), zero);
+            } else {
+                pixels = _mm_loadu_si128((const __m128i*)src);
+            }
+
+            __m128i result = fill;
+
+            for (int c = 0; c < 4; c++) {
+                // the field gets shifted into its byte right away, so
+                // the bit repetition has to stay within that byte
+                __m128i v = _mm_sll_epi32(_mm_srl_epi32(_mm_and_si128(pixels, masks[c]), shifts[c]), lshifts[c]);
+                __m128i byte = _mm_set1_epi32((int)(0xFFu << (c * 8)));
+                v = _mm_or_si128(v, _mm_and_si128(_mm_srl_epi32(v, n1[c]), byte));
+                v = _mm_or_si128(v, _mm_and_si128(_mm_srl_epi32(v, n2[c]), byte));
+                v = _mm_or_si128(v, _mm_and_si128(_mm_srl_epi32(v, n4[c]), byte));
+                result = _mm_or_si128(result, v);
+            }
+
+            _mm_storeu_si128((__m128i*)dst, result);
+
+            src += 4 * sbpp;
+            dst += 16;
+        }
+
+        UnpackBitfieldsScalar(src, sbpp, count, layout, dst);
+    }
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("avx2")
+    void UnpackBitfieldsAVX2(const u8* src, int sbpp, int count, const BitfieldsLayout& layout, u8* dst)
+    {
+        __m256i masks[4], shifts[4], lshifts[4], n1[4], n2[4], n4[4], bytes[4];
+
+        for (int c = 0; c < 4; c++) {
+            u32 n = layout.bits[c];
+            masks[c]   = _mm256_set1_epi32((int)layout.masks[c]);
+            shifts[c]  = _mm256_set1_epi32((int)layout.shifts[c]);
+            lshifts[c] = _mm256_set1_epi32((int)(8 - n + c * 8));
+            n1[c]      = _mm256_set1_epi32((int)n);
+            n2[c]      = _mm256_set1_epi32((int)n * 2);
+            n4[c]      = _mm256_set1_epi32((int)n * 4);
+            bytes[c]   = _mm256_set1_epi32((int)(0xFFu << (c * 8)));
+        }
+
+        __m256i fill = _mm256_set1_epi32((int)layout.fill);
+
+        for (; count >= 8; count -= 8) {
+            __m256i pixels;
+            if (sbpp == 2) {
+                pixels = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)src));
+            } else {
+                pixels = _mm256_loadu_si256((const __m256i*)src);
+            }
+
+            __m256i result = fill;
+
+            for (int c = 0; c < 4; c++) {
+                __m256i v = _mm256_sllv_epi32(_mm256_srlv_epi32(_mm256_and_si256(pixels, masks[c]), shifts[c]), lshifts[c]);
+                v = _mm256_or_si256(v, _mm256_and_si256(_mm256_srlv_epi32(v, n1[c]), bytes[c]));
+                v = _mm256_or_si256(v, _mm256_and_si256(_mm256_srlv_epi32(v, n2[c]), bytes[c]));
+                v = _mm256_or_si256(v, _mm256_and_si256(_mm256_srlv_epi32(v, n4[c]), bytes[c]));
+                result = _mm256_or_si256(result, v);
+            }
+
+            _mm256_storeu_si256((__m256i*)dst, result);
+
+            src += 8 * sbpp;
+            dst += 32;
+        }
+
+        UnpackBitfieldsSSE2(src, sbpp, count, layout, dst);
+    }
+
+#endif
+
+}
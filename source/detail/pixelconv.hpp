@@ -0,0 +1,60 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_PIXELCONV_HPP_INCLUDED
+#define AZURA_PIXELCONV_HPP_INCLUDED
+
+#include "../types.hpp"
+#include "../Image.hpp"
+#include "cpu.hpp"
+
+
+namespace azura {
+
+    // describes how to pull 8-bit blue, green, red and alpha channels out
+    // of 16 or 32-bit pixels with arbitrary channel masks
+    struct BitfieldsLayout {
+        u32 masks[4];
+        u32 shifts[4]; // brings the (top 8 bits of the) field down to bit 0
+        u32 bits[4];   // width of the field after shifting, 0 to 8
+        u32 fill;      // set for a missing alpha channel
+    };
+
+    void SetupBitfieldsLayout(BitfieldsLayout& layout, u32 red_mask, u32 green_mask, u32 blue_mask, u32 alpha_mask);
+
+    void SwizzlePixelsScalar(const u8* src, const PixelFormatDescriptor& spfd, u8* dst, const PixelFormatDescriptor& dpfd, int count);
+    void ExpandIndexedScalar(const u8* src, int count, const u8 table[256][4], int bpp, u8* dst);
+    void UnpackBitfieldsScalar(const u8* src, int sbpp, int count, const BitfieldsLayout& layout, u8* dst);
+
+#if defined(AZURA_X86)
+    void SwizzlePixelsSSSE3(const u8* src, const PixelFormatDescriptor& spfd, u8* dst, const PixelFormatDescriptor& dpfd, int count);
+    void ExpandIndexedAVX2(const u8* src, int count, const u8 table[256][4], int bpp, u8* dst);
+    void UnpackBitfieldsSSE2(const u8* src, int sbpp, int count, const BitfieldsLayout& layout, u8* dst);
+    void UnpackBitfieldsAVX2(const u8* src, int sbpp, int count, const BitfieldsLayout& layout, u8* dst);
+#endif
+
+}
+
+
+#endif
@@ -22,14 +22,22 @@
     THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <csetjmp>
 #include <cstring>
 #include <png.h>
+#include <zlib.h>
 
 #include "../ArrayAutoPtr.hpp"
 #include "../ImageImpl.hpp"
 #include "png.hpp"
+#include "pngdeflate.hpp"
+#include "pngfast.hpp"
+#include "pngreduce.hpp"
+
+#define IDAT_SIZE (1 << 20) /* largest IDAT chunk written by the parallel encoder */
 
 
 namespace azura {
@@ -47,52 +55,86 @@ namespace azura {
     }
 
     //-----------------------------------------------------------------
-    Image::Ptr ReadPNG(File* file)
+    // returns the azIX chunk read along with the header, if the image
+    // data it describes can be decoded without any transformations
+    static const png_unknown_chunk* find_strip_index(png_structp png_ptr, png_infop info_ptr)
     {
-        assert(file);
+        int bit_depth  = png_get_bit_depth(png_ptr, info_ptr);
+        int color_type = png_get_color_type(png_ptr, info_ptr);
 
-        if (!file) {
+        if (bit_depth != 8 || png_get_interlace_type(png_ptr, info_ptr) != PNG_INTERLACE_NONE ||
+            (color_type != PNG_COLOR_TYPE_PALETTE && color_type != PNG_COLOR_TYPE_RGB && color_type != PNG_COLOR_TYPE_RGB_ALPHA))
+        {
             return 0;
         }
 
-        // initialize the necessary libpng data structures
-        png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
-        if (!png_ptr) {
-            return 0;
-        }
-        png_infop info_ptr = png_create_info_struct(png_ptr);
-        if (!info_ptr) {
-            png_destroy_read_struct(&png_ptr, 0, 0);
-            return 0;
-        }
+        png_unknown_chunkp chunks = 0;
+        int num_chunks = png_get_unknown_chunks(png_ptr, info_ptr, &chunks);
 
-        // check if the file is actually a PNG file
-        u8 sig_buf[8];
-        if (file->read(sig_buf, 8) != 8 || png_sig_cmp(sig_buf, 0, 8) != 0) {
-            png_destroy_read_struct(&png_ptr, &info_ptr, 0);
-            return 0;
+        for (int i = 0; i < num_chunks; i++) {
+            if (std::memcmp(chunks[i].name, AZURA_PNG_STRIP_INDEX, 4) == 0) {
+                return &chunks[i];
+            }
         }
 
-        // libpng uses SJLJ for error handling, so we need to define
-        // any automatic variables before the call to setjmp()
-        Image::Ptr image;
-        ArrayAutoPtr<png_bytep> rows;
+        return 0;
+    }
 
-        // establish a return point
-        if (setjmp(png_jmpbuf(png_ptr)) != 0) {
-            png_destroy_read_struct(&png_ptr, &info_ptr, 0);
-            return 0;
+    //-----------------------------------------------------------------
+    // collects the contents of all IDAT chunks; png_read_info() stops
+    // right after the header of the first one, so we step back to it
+    static bool read_image_data(File* file, ByteArray& stream, bool verify_crc)
+    {
+        if (!file->seek(-8, File::Current)) {
+            return false;
         }
 
-        // tell libpng that we are already 8 bytes into the image file
-        png_set_sig_bytes(png_ptr, 8);
+        int size = 0;
 
-        // tell libpng that we are going to use our own io functions
-        png_set_read_fn(png_ptr, file, read_callback);
+        while (true) {
+            u8 header[8];
+            if (file->read(header, 8) != 8) {
+                return false;
+            }
 
-        // read the png header
-        png_read_info(png_ptr, info_ptr);
+            u32 length = png_get_uint_32(header);
+            if (std::memcmp(header + 4, "IDAT", 4) != 0) {
+                break;
+            }
+
+            if (length > PNG_UINT_31_MAX || (int)length > INT_MAX - size) {
+                return false;
+            }
+
+            if (size + (int)length > stream.getSize()) {
+                stream.resize(std::max(size + (int)length, stream.getSize() * 2));
+            }
+
+            u8 crc_buf[4];
+            if (file->read(stream.getBuffer() + size, length) != (int)length || file->read(crc_buf, 4) != 4) {
+                return false;
+            }
+
+            if (verify_crc) {
+                uLong crc = crc32(crc32(0, header + 4, 4), stream.getBuffer() + size, length);
+                if ((u32)crc != png_get_uint_32(crc_buf)) {
+                    return false;
+                }
+            }
+
+            size += length;
+        }
 
+        stream.resize(size);
+
+        return size > 0;
+    }
+
+    //-----------------------------------------------------------------
+    // sets up the transformations for the image described by info_ptr
+    // and allocates an image to decode it into
+    static Image::Ptr create_image(png_structp png_ptr, png_infop info_ptr)
+    {
         // get the image attributes
         int img_width      = png_get_image_width(png_ptr, info_ptr);
         int img_height     = png_get_image_height(png_ptr, info_ptr);
@@ -104,25 +146,48 @@ namespace azura {
             png_set_strip_16(png_ptr);
         }
 
-        // Note: Not sure if we need this, or if it's correct what we are doing here.
-        // if the image has a tRNS chunk, use it for the alpha channel
-        //if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
-        //    png_set_tRNS_to_alpha(png_ptr);
-        //}
+        Image::Ptr image;
 
         switch (img_color_type)
         {
             case PNG_COLOR_TYPE_PALETTE:
             {
-                image = new ImageImpl(img_width, img_height, PixelFormat::RGB_P8);
+                // unpack 1, 2 and 4 bit indices into one byte each
+                if (img_bit_depth < 8) {
+                    png_set_packing(png_ptr);
+                }
 
                 // get palette
                 png_colorp palette = 0;
                 int num_palette = 0;
                 png_get_PLTE(png_ptr, info_ptr, &palette, &num_palette);
 
-                // copy palette over to image
-                std::memcpy(image->getPalette(), palette, num_palette * sizeof(RGB));
+                // get palette transparency, if any
+                png_bytep trans_alpha = 0;
+                int num_trans = 0;
+                if (png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+                    png_get_tRNS(png_ptr, info_ptr, &trans_alpha, &num_trans, 0);
+                }
+
+                if (num_trans > 0) {
+                    // keep the image indexed and merge tRNS into the palette
+                    image = new ImageImpl(img_width, img_height, PixelFormat::RGBA_P8);
+
+                    RGBA* plt = image->getAlphaPalette();
+                    for (int i = 0; i < 256; i++) {
+                        if (i < num_palette) {
+                            plt[i].red   = palette[i].red;
+                            plt[i].green = palette[i].green;
+                            plt[i].blue  = palette[i].blue;
+                        }
+                        plt[i].alpha = (i < num_trans ? trans_alpha[i] : 255);
+                    }
+                } else {
+                    image = new ImageImpl(img_width, img_height, PixelFormat::RGB_P8);
+
+                    // copy palette over to image
+                    std::memcpy(image->getPalette(), palette, num_palette * sizeof(RGB));
+                }
 
                 break;
             }
@@ -149,10 +214,96 @@ namespace azura {
                 break;
             }
             default: // shouldn't happen
-                png_destroy_read_struct(&png_ptr, &info_ptr, 0);
                 return 0;
         }
 
+        return image;
+
+    }
+
+    //-----------------------------------------------------------------
+    Image::Ptr ReadPNG(File* file, const PngReadOptions& options)
+    {
+        assert(file);
+
+        if (!file) {
+            return 0;
+        }
+
+        // initialize the necessary libpng data structures
+        png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+        if (!png_ptr) {
+            return 0;
+        }
+        png_infop info_ptr = png_create_info_struct(png_ptr);
+        if (!info_ptr) {
+            png_destroy_read_struct(&png_ptr, 0, 0);
+            return 0;
+        }
+
+        // check if the file is actually a PNG file
+        u8 sig_buf[8];
+        if (file->read(sig_buf, 8) != 8 || png_sig_cmp(sig_buf, 0, 8) != 0) {
+            png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+            return 0;
+        }
+
+        // libpng uses SJLJ for error handling, so we need to define
+        // any automatic variables before the call to setjmp()
+        Image::Ptr image;
+        ArrayAutoPtr<png_bytep> rows;
+        ByteArray stream;
+
+        // establish a return point
+        if (setjmp(png_jmpbuf(png_ptr)) != 0) {
+            png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+            return 0;
+        }
+
+        // tell libpng that we are already 8 bytes into the image file
+        png_set_sig_bytes(png_ptr, 8);
+
+        // tell libpng that we are going to use our own io functions
+        png_set_read_fn(png_ptr, file, read_callback);
+
+        if (!options.verifyChecksums) {
+            // neither compute nor compare the chunk CRCs and the Adler-32
+            // of the image data, corrupt data then decodes to garbage
+            png_set_crc_action(png_ptr, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
+            png_set_option(png_ptr, PNG_IGNORE_ADLER32, PNG_OPTION_ON);
+        }
+
+        // keep the strip index of files we wrote, if there is one
+        png_set_keep_unknown_chunks(png_ptr, PNG_HANDLE_CHUNK_ALWAYS, (png_const_bytep)AZURA_PNG_STRIP_INDEX, 1);
+
+        // read the png header
+        png_read_info(png_ptr, info_ptr);
+
+        // set up the image and the transformations
+        image = create_image(png_ptr, info_ptr);
+        if (!image) {
+            png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+            return 0;
+        }
+
+        const png_unknown_chunk* strip_index = find_strip_index(png_ptr, info_ptr);
+
+        if (strip_index) {
+            // the rows come in bands that can be decoded independently
+            PixelFormatDescriptor pfd = Image::GetPixelFormatDescriptor(image->getPixelFormat());
+
+            bool ok = read_image_data(file, stream, options.verifyChecksums) &&
+                      InflateRowsParallel(stream.getBuffer(), stream.getSize(), strip_index->data, (int)strip_index->size,
+                                          image->getPixels(), image->getWidth(), image->getHeight(), pfd.bytesPerPixel,
+                                          options.verifyChecksums);
+
+            png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+            return (ok ? image : Image::Ptr());
+        }
+
+        int img_width  = image->getWidth();
+        int img_height = image->getHeight();
+
         // prepare an array of row pointers for libpng
         PixelFormatDescriptor pfd = Image::GetPixelFormatDescriptor(image->getPixelFormat());
         rows = new png_bytep[img_height];
@@ -172,6 +323,210 @@ namespace azura {
         return image;
     }
 
+    namespace {
+
+        class PngPushDecoder : public PushDecoder {
+        public:
+            PngPushDecoder(PushDecoder::Listener* listener);
+            ~PngPushDecoder();
+
+            bool init();
+
+            bool push(const u8* data, int size);
+
+            bool isComplete() const;
+            bool hasFailed() const;
+
+            Image::Ptr getImage();
+
+        private:
+            static void infoCallback(png_structp png_ptr, png_infop info_ptr);
+            static void rowCallback(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num, int pass);
+            static void endCallback(png_structp png_ptr, png_infop info_ptr);
+
+            void destroy();
+
+        private:
+            PushDecoder::Listener* _listener;
+            png_structp _png;
+            png_infop _info;
+            Image::Ptr _image;
+            int _pitch;
+            bool _complete;
+            bool _failed;
+        };
+
+    }
+
+    //-----------------------------------------------------------------
+    PngPushDecoder::PngPushDecoder(PushDecoder::Listener* listener)
+        : _listener(listener)
+        , _png(0)
+        , _info(0)
+        , _pitch(0)
+        , _complete(false)
+        , _failed(false)
+    {
+    }
+
+    //-----------------------------------------------------------------
+    PngPushDecoder::~PngPushDecoder()
+    {
+        destroy();
+    }
+
+    //-----------------------------------------------------------------
+    bool
+    PngPushDecoder::init()
+    {
+        // initialize the necessary libpng data structures
+        _png = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+        if (!_png) {
+            return false;
+        }
+        _info = png_create_info_struct(_png);
+        if (!_info) {
+            destroy();
+            return false;
+        }
+
+        // establish a return point
+        if (setjmp(png_jmpbuf(_png)) != 0) {
+            destroy();
+            return false;
+        }
+
+        // libpng calls back as soon as something has been decoded
+        png_set_progressive_read_fn(_png, this, infoCallback, rowCallback, endCallback);
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------
+    void
+    PngPushDecoder::destroy()
+    {
+        if (_png) {
+            png_destroy_read_struct(&_png, (_info ? &_info : 0), 0);
+            _png  = 0;
+            _info = 0;
+        }
+    }
+
+    //-----------------------------------------------------------------
+    bool
+    PngPushDecoder::push(const u8* data, int size)
+    {
+        if (_failed || !_png) {
+            _failed = true;
+            return false;
+        }
+
+        if (_complete || size <= 0) {
+            // anything after the end of the image is ignored
+            return true;
+        }
+
+        // establish a return point
+        if (setjmp(png_jmpbuf(_png)) != 0) {
+            _failed = true;
+            destroy();
+            return false;
+        }
+
+        png_process_data(_png, _info, (png_bytep)data, size);
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------
+    bool
+    PngPushDecoder::isComplete() const
+    {
+        return _complete;
+    }
+
+    //-----------------------------------------------------------------
+    bool
+    PngPushDecoder::hasFailed() const
+    {
+        return _failed;
+    }
+
+    //-----------------------------------------------------------------
+    Image::Ptr
+    PngPushDecoder::getImage()
+    {
+        return _image;
+    }
+
+    //-----------------------------------------------------------------
+    void
+    PngPushDecoder::infoCallback(png_structp png_ptr, png_infop info_ptr)
+    {
+        PngPushDecoder* decoder = (PngPushDecoder*)png_get_progressive_ptr(png_ptr);
+
+        decoder->_image = create_image(png_ptr, info_ptr);
+        if (!decoder->_image) {
+            png_error(png_ptr, "unsupported color type");
+        }
+
+        PixelFormatDescriptor pfd = Image::GetPixelFormatDescriptor(decoder->_image->getPixelFormat());
+        decoder->_pitch = decoder->_image->getWidth() * pfd.bytesPerPixel;
+
+        // interlaced images get expanded into their final rows pass by pass
+        png_set_interlace_handling(png_ptr);
+        png_read_update_info(png_ptr, info_ptr);
+
+        if (decoder->_listener) {
+            decoder->_listener->onHeader(decoder, decoder->_image.get());
+        }
+    }
+
+    //-----------------------------------------------------------------
+    void
+    PngPushDecoder::rowCallback(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num, int pass)
+    {
+        PngPushDecoder* decoder = (PngPushDecoder*)png_get_progressive_ptr(png_ptr);
+
+        if (!new_row) {
+            // this pass doesn't touch the row
+            return;
+        }
+
+        u8* row = decoder->_image->getPixels() + row_num * decoder->_pitch;
+        png_progressive_combine_row(png_ptr, row, new_row);
+
+        if (decoder->_listener) {
+            decoder->_listener->onRow(decoder, (int)row_num, pass);
+        }
+    }
+
+    //-----------------------------------------------------------------
+    void
+    PngPushDecoder::endCallback(png_structp png_ptr, png_infop /* info_ptr */)
+    {
+        PngPushDecoder* decoder = (PngPushDecoder*)png_get_progressive_ptr(png_ptr);
+
+        decoder->_complete = true;
+
+        if (decoder->_listener) {
+            decoder->_listener->onComplete(decoder);
+        }
+    }
+
+    //-----------------------------------------------------------------
+    PushDecoder::Ptr CreatePngPushDecoder(PushDecoder::Listener* listener)
+    {
+        RefPtr<PngPushDecoder> decoder = new PngPushDecoder(listener);
+
+        if (!decoder->init()) {
+            return 0;
+        }
+
+        return decoder;
+    }
+
     //-----------------------------------------------------------------
     static void write_callback(png_structp png_ptr, png_bytep buffer, png_size_t size)
     {
@@ -195,32 +550,94 @@ namespace azura {
     }
 
     //-----------------------------------------------------------------
-    bool WritePNG(Image* image, File* file)
+    static void set_reduced_attributes(png_structp png_ptr, png_infop info_ptr, int width, int height, const PngReducedImage& reduced)
     {
-        if (!image || !file) {
-            return false;
-        }
+        png_set_IHDR(
+            png_ptr,
+            info_ptr,
+            width,
+            height,
+            reduced.bitDepth,
+            reduced.colorType,
+            PNG_INTERLACE_NONE,
+            PNG_COMPRESSION_TYPE_DEFAULT,
+            PNG_FILTER_TYPE_DEFAULT
+        );
+
+        if (reduced.colorType == PNG_COLOR_TYPE_PALETTE) {
+            png_color plt[256];
+            png_byte trans[256];
+            int num_trans = 0;
+
+            for (int i = 0; i < reduced.paletteSize; i++) {
+                plt[i].red   = reduced.palette[i].red;
+                plt[i].green = reduced.palette[i].green;
+                plt[i].blue  = reduced.palette[i].blue;
+                trans[i]     = reduced.palette[i].alpha;
+
+                // the translucent entries come first
+                if (trans[i] != 255) {
+                    num_trans = i + 1;
+                }
+            }
 
-        Image::Ptr src_image = image;
+            png_set_PLTE(png_ptr, info_ptr, plt, reduced.paletteSize);
 
-        switch (src_image->getPixelFormat()) {
+            if (num_trans > 0) {
+                png_set_tRNS(png_ptr, info_ptr, trans, num_trans, 0);
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------
+    static Image::Ptr get_writable_image(Image* image)
+    {
+        switch (image->getPixelFormat()) {
             case PixelFormat::RGB_P8:
+            case PixelFormat::RGBA_P8:
             case PixelFormat::RGB:
             case PixelFormat::RGBA:
                 // ok, we can handle these directly
-                break;
+                return image;
             case PixelFormat::BGR:
                 // convert to RGB
-                src_image = src_image->convert(PixelFormat::RGB);
-                break;
+                return image->convert(PixelFormat::RGB);
             case PixelFormat::BGRA:
                 // convert to RGBA
-                src_image = src_image->convert(PixelFormat::RGBA);
-                break;
+                return image->convert(PixelFormat::RGBA);
             default: // shouldn't happen
-                return false;
+                return 0;
+        }
+    }
+
+    //-----------------------------------------------------------------
+    bool WritePNG(Image* image, File* file, const PngWriteOptions& options)
+    {
+        if (!image || !file) {
+            return false;
+        }
+
+        if (options.compressionLevel < 0 || options.compressionLevel > 9 ||
+            options.memLevel < 1 || options.memLevel > 9 ||
+            options.windowBits < 8 || options.windowBits > 15 ||
+            options.strategy < PngStrategy::Auto || options.strategy >= PngStrategy::Count ||
+            (options.filters & ~PngFilters::All) != 0 ||
+            options.encoder < 0 || options.encoder >= PngEncoder::Count)
+        {
+            // invalid options
+            return false;
+        }
+
+        Image::Ptr src_image = get_writable_image(image);
+        if (!src_image) {
+            return false;
         }
 
+        // look for a smaller representation first; files with a strip
+        // index must stay readable by InflateRowsParallel()
+        PngReducedImage reduced;
+        bool is_reduced = options.reduceColorType && ReduceColorType(src_image.get(), options.encoder == PngEncoder::Indexed, reduced);
+
         // initialize the necessary libpng data structures
         png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
         if (!png_ptr) {
@@ -235,6 +652,8 @@ namespace azura {
         // libpng uses SJLJ for error handling, so we need to define
         // any automatic variables before the call to setjmp()
         ArrayAutoPtr<png_bytep> rows;
+        ByteArray stream;
+        ByteArray strip_index;
 
         // establish a return point
         if (setjmp(png_jmpbuf(png_ptr)) != 0) {
@@ -245,73 +664,183 @@ namespace azura {
         // tell libpng that we are going to use our own io functions
         png_set_write_fn(png_ptr, file, write_callback, flush_callback);
 
+        // set up the compression
+        png_set_compression_level(png_ptr, options.compressionLevel);
+        png_set_compression_mem_level(png_ptr, options.memLevel);
+        png_set_compression_window_bits(png_ptr, options.windowBits);
+
+        if (options.strategy != PngStrategy::Auto) {
+            png_set_compression_strategy(png_ptr, options.strategy);
+        }
+
+        if (options.filters != PngFilters::Auto) {
+            png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, options.filters);
+        }
+
         // set the image attributes
-        switch (src_image->getPixelFormat())
-        {
-            case PixelFormat::RGB_P8:
+        if (is_reduced) {
+            set_reduced_attributes(png_ptr, info_ptr, src_image->getWidth(), src_image->getHeight(), reduced);
+        } else {
+            switch (src_image->getPixelFormat())
             {
-                png_set_IHDR(
-                    png_ptr,
-                    info_ptr,
-                    src_image->getWidth(),
-                    src_image->getHeight(),
-                    8, /* 8 bits per channel */
-                    PNG_COLOR_TYPE_PALETTE,
-                    PNG_INTERLACE_NONE,
-                    PNG_COMPRESSION_TYPE_DEFAULT,
-                    PNG_FILTER_TYPE_DEFAULT
-                );
-                png_set_PLTE(
-                    png_ptr,
-                    info_ptr,
-                    (png_colorp)src_image->getPalette(),
-                    256 /* size of palette */
-                );
-                break;
+                case PixelFormat::RGB_P8:
+                {
+                    png_set_IHDR(
+                        png_ptr,
+                        info_ptr,
+                        src_image->getWidth(),
+                        src_image->getHeight(),
+                        8, /* 8 bits per channel */
+                        PNG_COLOR_TYPE_PALETTE,
+                        PNG_INTERLACE_NONE,
+                        PNG_COMPRESSION_TYPE_DEFAULT,
+                        PNG_FILTER_TYPE_DEFAULT
+                    );
+                    png_set_PLTE(
+                        png_ptr,
+                        info_ptr,
+                        (png_colorp)src_image->getPalette(),
+                        256 /* size of palette */
+                    );
+                    break;
+                }
+                case PixelFormat::RGBA_P8:
+                {
+                    png_set_IHDR(
+                        png_ptr,
+                        info_ptr,
+                        src_image->getWidth(),
+                        src_image->getHeight(),
+                        8, /* 8 bits per channel */
+                        PNG_COLOR_TYPE_PALETTE,
+                        PNG_INTERLACE_NONE,
+                        PNG_COMPRESSION_TYPE_DEFAULT,
+                        PNG_FILTER_TYPE_DEFAULT
+                    );
+
+                    // split the palette into PLTE and tRNS
+                    const RGBA* src_plt = src_image->getAlphaPalette();
+                    png_color plt[256];
+                    png_byte trans[256];
+                    int num_trans = 0;
+
+                    for (int i = 0; i < 256; i++) {
+                        plt[i].red   = src_plt[i].red;
+                        plt[i].green = src_plt[i].green;
+                        plt[i].blue  = src_plt[i].blue;
+                        trans[i]     = src_plt[i].alpha;
+
+                        // trailing opaque entries can be omitted from tRNS
+                        if (trans[i] != 255) {
+                            num_trans = i + 1;
+                        }
+                    }
+
+                    png_set_PLTE(
+                        png_ptr,
+                        info_ptr,
+                        plt,
+                        256 /* size of palette */
+                    );
+
+                    if (num_trans > 0) {
+                        png_set_tRNS(png_ptr, info_ptr, trans, num_trans, 0);
+                    }
+
+                    break;
+                }
+                case PixelFormat::RGB:
+                {
+                    png_set_IHDR(
+                        png_ptr,
+                        info_ptr,
+                        src_image->getWidth(),
+                        src_image->getHeight(),
+                        8, /* 8 bits per channel */
+                        PNG_COLOR_TYPE_RGB,
+                        PNG_INTERLACE_NONE,
+                        PNG_COMPRESSION_TYPE_DEFAULT,
+                        PNG_FILTER_TYPE_DEFAULT
+                    );
+                    break;
+                }
+                case PixelFormat::RGBA:
+                {
+                    png_set_IHDR(
+                        png_ptr,
+                        info_ptr,
+                        src_image->getWidth(),
+                        src_image->getHeight(),
+                        8, /* 8 bits per channel */
+                        PNG_COLOR_TYPE_RGB_ALPHA,
+                        PNG_INTERLACE_NONE,
+                        PNG_COMPRESSION_TYPE_DEFAULT,
+                        PNG_FILTER_TYPE_DEFAULT
+                    );
+                    break;
+                }
+                default: // shouldn't happen
+                    png_destroy_write_struct(&png_ptr, &info_ptr);
+                    return false;
             }
-            case PixelFormat::RGB:
-            {
-                png_set_IHDR(
-                    png_ptr,
-                    info_ptr,
-                    src_image->getWidth(),
-                    src_image->getHeight(),
-                    8, /* 8 bits per channel */
-                    PNG_COLOR_TYPE_RGB,
-                    PNG_INTERLACE_NONE,
-                    PNG_COMPRESSION_TYPE_DEFAULT,
-                    PNG_FILTER_TYPE_DEFAULT
-                );
-                break;
-            }
-            case PixelFormat::RGBA:
-            {
-                png_set_IHDR(
-                    png_ptr,
-                    info_ptr,
-                    src_image->getWidth(),
-                    src_image->getHeight(),
-                    8, /* 8 bits per channel */
-                    PNG_COLOR_TYPE_RGB_ALPHA,
-                    PNG_INTERLACE_NONE,
-                    PNG_COMPRESSION_TYPE_DEFAULT,
-                    PNG_FILTER_TYPE_DEFAULT
-                );
-                break;
+        }
+
+        // the rows as they go into the file
+        PixelFormatDescriptor pfd = Image::GetPixelFormatDescriptor(src_image->getPixelFormat());
+        const u8* pixels = src_image->getPixels();
+        int pitch = src_image->getWidth() * pfd.bytesPerPixel;
+        int bpp = pfd.bytesPerPixel;
+        bool palettized = !pfd.isDirectColor;
+
+        if (is_reduced) {
+            pixels = reduced.pixels.getBuffer();
+            pitch = reduced.pitch;
+            bpp = reduced.bytesPerPixel;
+            palettized = (reduced.colorType == PNG_COLOR_TYPE_PALETTE || reduced.bitDepth < 8);
+        }
+
+        if (options.encoder != PngEncoder::Standard) {
+            // compress everything up front, libpng only writes the chunks;
+            // packed rows are filtered bytewise, as if they were 8 bit gray
+            bool indexed = (options.encoder == PngEncoder::Indexed);
+            bool compressed;
+
+            if (options.encoder == PngEncoder::Fast) {
+                compressed = DeflateRowsFast(pixels, pitch / bpp, src_image->getHeight(), bpp, palettized, stream);
+            } else {
+                compressed = DeflateRowsParallel(pixels, pitch / bpp, src_image->getHeight(), bpp, palettized, options, stream, indexed ? &strip_index : 0);
             }
-            default: // shouldn't happen
+
+            if (!compressed) {
                 png_destroy_write_struct(&png_ptr, &info_ptr);
                 return false;
+            }
+
+            png_write_info(png_ptr, info_ptr);
+
+            if (indexed) {
+                png_write_chunk(png_ptr, (png_const_bytep)AZURA_PNG_STRIP_INDEX, strip_index.getBuffer(), strip_index.getSize());
+            }
+
+            for (int offset = 0; offset < stream.getSize(); offset += IDAT_SIZE) {
+                int size = std::min(stream.getSize() - offset, IDAT_SIZE);
+                png_write_chunk(png_ptr, (png_const_bytep)"IDAT", stream.getBuffer() + offset, size);
+            }
+
+            png_write_chunk(png_ptr, (png_const_bytep)"IEND", 0, 0);
+            flush_callback(png_ptr);
+
+            png_destroy_write_struct(&png_ptr, &info_ptr);
+            return true;
         }
 
         // write png header
         png_write_info(png_ptr, info_ptr);
 
         // prepare an array of row pointers for libpng
-        PixelFormatDescriptor pfd = Image::GetPixelFormatDescriptor(src_image->getPixelFormat());
         rows = new png_bytep[src_image->getHeight()];
         for (int i = 0; i < src_image->getHeight(); ++i) {
-            rows[i] = (png_bytep)(src_image->getPixels() + i * src_image->getWidth() * pfd.bytesPerPixel);
+            rows[i] = (png_bytep)(pixels + i * pitch);
         }
 
         // write image data
@@ -27,12 +27,15 @@
 
 #include "../../File.hpp"
 #include "../../Image.hpp"
+#include "../../options.hpp"
+#include "../../PushDecoder.hpp"
 
 
 namespace azura {
 
-    Image::Ptr ReadPNG(File* file);
-    bool WritePNG(Image* image, File* file);
+    Image::Ptr ReadPNG(File* file, const PngReadOptions& options = PngReadOptions());
+    PushDecoder::Ptr CreatePngPushDecoder(PushDecoder::Listener* listener);
+    bool WritePNG(Image* image, File* file, const PngWriteOptions& options = PngWriteOptions());
 
 }
 
@@ -0,0 +1,411 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "../ArrayAutoPtr.hpp"
+#include "../thread.hpp"
+#include "pngdeflate.hpp"
+#include "pngfilter.hpp"
+
+#define BAND_SIZE (256 * 1024) /* filtered bytes per band, at least one row */
+#define DICT_SIZE 32768        /* largest window deflate can refer back to */
+
+
+namespace azura {
+
+    namespace {
+
+        class FilterRowsTask : public ParallelTask {
+        public:
+            const u8* pixels;
+            int       pitch;
+            int       height;
+            int       bpp;
+            int       filters;
+            int       rowsPerBand;
+            bool      independent;
+            u8*       filtered;
+
+            void run(int band)
+            {
+                int begin = band * rowsPerBand;
+                int end = std::min(begin + rowsPerBand, height);
+
+                ArrayAutoPtr<u8> scratch = new u8[pitch];
+
+                for (int y = begin; y < end; y++) {
+                    const u8* row = pixels + (size_t)y * pitch;
+                    const u8* prev = (y > 0 ? row - pitch : 0);
+
+                    int row_filters = filters;
+                    if (independent && y == begin && y > 0) {
+                        // the row above belongs to another band
+                        row_filters &= PngFilters::None | PngFilters::Sub;
+                        if (!row_filters) {
+                            row_filters = PngFilters::None;
+                        }
+                    }
+
+                    FilterRowAdaptive(row_filters, row, prev, pitch, bpp, filtered + (size_t)y * (pitch + 1), scratch.get());
+                }
+            }
+        };
+
+        class DeflateBandsTask : public ParallelTask {
+        public:
+            const u8*  filtered;
+            size_t     filteredSize;
+            size_t     bandSize;
+            int        bandCount;
+            int        level;
+            int        memLevel;
+            int        windowBits;
+            int        strategy;
+            bool       independent;
+            ByteArray* outputs;
+            uLong*     checksums;
+            bool*      failed;
+
+            void run(int band)
+            {
+                size_t begin = band * bandSize;
+                size_t size = std::min(bandSize, filteredSize - begin);
+                bool last = (band == bandCount - 1);
+
+                z_stream zs;
+                std::memset(&zs, 0, sizeof(zs));
+
+                // raw deflate, the zlib wrapper is written around all bands
+                if (deflateInit2(&zs, level, Z_DEFLATED, -windowBits, memLevel, strategy) != Z_OK) {
+                    failed[band] = true;
+                    return;
+                }
+
+                if (begin > 0 && !independent) {
+                    size_t dict_size = std::min((size_t)DICT_SIZE, begin);
+                    deflateSetDictionary(&zs, filtered + begin - dict_size, (uInt)dict_size);
+                }
+
+                // room for the sync flush marker on top of the bound
+                ByteArray& out = outputs[band];
+                out.resize((int)deflateBound(&zs, (uLong)size) + 16);
+
+                zs.next_in   = (Bytef*)(filtered + begin);
+                zs.avail_in  = (uInt)size;
+                zs.next_out  = out.getBuffer();
+                zs.avail_out = (uInt)out.getSize();
+
+                int ret = deflate(&zs, last ? Z_FINISH : (independent ? Z_FULL_FLUSH : Z_SYNC_FLUSH));
+
+                if ((last ? ret != Z_STREAM_END : ret != Z_OK) || zs.avail_in != 0) {
+                    failed[band] = true;
+                } else {
+                    out.resize(out.getSize() - (int)zs.avail_out);
+                    checksums[band] = adler32(adler32(0, 0, 0), filtered + begin, (uInt)size);
+                }
+
+                deflateEnd(&zs);
+            }
+        };
+
+        class InflateBandsTask : public ParallelTask {
+        public:
+            const u8* stream;
+            const u32* offsets;    /* band starts, plus the trailer's */
+            int       rowsPerBand;
+            int       height;
+            int       pitch;
+            int       bpp;
+            u8*       pixels;
+            bool      verify;
+            uLong*    checksums;
+            bool*     failed;
+
+            void run(int band)
+            {
+                int begin = band * rowsPerBand;
+                int end = std::min(begin + rowsPerBand, height);
+                bool last = (end == height);
+
+                size_t size = (size_t)(end - begin) * (pitch + 1);
+                ArrayAutoPtr<u8> filtered = new u8[size];
+
+                z_stream zs;
+                std::memset(&zs, 0, sizeof(zs));
+
+                if (inflateInit2(&zs, -15) != Z_OK) {
+                    failed[band] = true;
+                    return;
+                }
+
+                zs.next_in   = (Bytef*)(stream + offsets[band]);
+                zs.avail_in  = offsets[band + 1] - offsets[band];
+                zs.next_out  = filtered.get();
+                zs.avail_out = (uInt)size;
+
+                int ret = inflate(&zs, Z_SYNC_FLUSH);
+                inflateEnd(&zs);
+
+                // only the last band ends the deflate stream
+                if (zs.avail_out != 0 || (last ? ret != Z_STREAM_END : ret != Z_OK)) {
+                    failed[band] = true;
+                    return;
+                }
+
+                if (verify) {
+                    checksums[band] = adler32(adler32(0, 0, 0), filtered.get(), (uInt)size);
+                }
+
+                for (int y = begin; y < end; y++) {
+                    const u8* src = filtered.get() + (size_t)(y - begin) * (pitch + 1);
+                    u8* row = pixels + (size_t)y * pitch;
+
+                    if (y == begin && y > 0 && src[0] != PngFilterType::None && src[0] != PngFilterType::Sub) {
+                        // refers to a row of another band
+                        failed[band] = true;
+                        return;
+                    }
+
+                    if (!UnfilterRow(src[0], src + 1, (y > begin ? row - pitch : 0), pitch, bpp, row)) {
+                        failed[band] = true;
+                        return;
+                    }
+                }
+            }
+        };
+
+        inline void put_uint32_be(u8* dst, u32 value)
+        {
+            dst[0] = (u8)(value >> 24);
+            dst[1] = (u8)(value >> 16);
+            dst[2] = (u8)(value >> 8);
+            dst[3] = (u8)(value);
+        }
+
+        inline u32 get_uint32_be(const u8* src)
+        {
+            return ((u32)src[0] << 24) | ((u32)src[1] << 16) | ((u32)src[2] << 8) | src[3];
+        }
+
+    }
+
+    //-----------------------------------------------------------------
+    bool DeflateRowsParallel(const u8* pixels, int width, int height, int bpp, bool palettized, const PngWriteOptions& options, ByteArray& stream, ByteArray* strip_index)
+    {
+        if (!pixels || width <= 0 || height <= 0 || bpp <= 0) {
+            return false;
+        }
+
+        int pitch = width * bpp;
+
+        // same defaults as libpng's
+        int filters = options.filters;
+        if (filters == PngFilters::Auto) {
+            filters = (palettized ? PngFilters::None : PngFilters::All);
+        }
+
+        int strategy = options.strategy;
+        if (strategy == PngStrategy::Auto) {
+            strategy = (filters == PngFilters::None ? Z_DEFAULT_STRATEGY : Z_FILTERED);
+        }
+
+        // zlib doesn't do 256 byte windows and quietly uses 512 bytes
+        int window_bits = std::max(options.windowBits, 9);
+
+        // whole rows per band, so that the bands can be filtered separately
+        int rows_per_band = std::min(std::max(BAND_SIZE / (pitch + 1), 1), height);
+        int band_count = (height + rows_per_band - 1) / rows_per_band;
+
+        size_t filtered_size = (size_t)height * (pitch + 1);
+        ArrayAutoPtr<u8> filtered = new u8[filtered_size];
+
+        FilterRowsTask filter_task;
+        filter_task.pixels      = pixels;
+        filter_task.pitch       = pitch;
+        filter_task.height      = height;
+        filter_task.bpp         = bpp;
+        filter_task.filters     = filters;
+        filter_task.rowsPerBand = rows_per_band;
+        filter_task.independent = (strip_index != 0);
+        filter_task.filtered    = filtered.get();
+        RunParallel(filter_task, band_count);
+
+        ArrayAutoPtr<ByteArray> outputs = new ByteArray[band_count];
+        ArrayAutoPtr<uLong> checksums = new uLong[band_count];
+        ArrayAutoPtr<bool> failed = new bool[band_count];
+        std::fill(failed.get(), failed.get() + band_count, false);
+
+        DeflateBandsTask deflate_task;
+        deflate_task.filtered     = filtered.get();
+        deflate_task.filteredSize = filtered_size;
+        deflate_task.bandSize     = (size_t)rows_per_band * (pitch + 1);
+        deflate_task.bandCount    = band_count;
+        deflate_task.level        = options.compressionLevel;
+        deflate_task.memLevel     = options.memLevel;
+        deflate_task.windowBits   = window_bits;
+        deflate_task.strategy     = strategy;
+        deflate_task.independent  = (strip_index != 0);
+        deflate_task.outputs      = outputs.get();
+        deflate_task.checksums    = checksums.get();
+        deflate_task.failed       = failed.get();
+        RunParallel(deflate_task, band_count);
+
+        // join the bands between the zlib header and trailer
+        int stream_size = 2 + 4;
+        for (int i = 0; i < band_count; i++) {
+            if (failed[i]) {
+                return false;
+            }
+            stream_size += outputs[i].getSize();
+        }
+
+        stream.resize(stream_size);
+        u8* dst = stream.getBuffer();
+
+        // header as zlib writes it, the level hint included
+        int level_flags;
+        if (strategy >= Z_HUFFMAN_ONLY || options.compressionLevel < 2) {
+            level_flags = 0;
+        } else if (options.compressionLevel < 6) {
+            level_flags = 1;
+        } else if (options.compressionLevel == 6) {
+            level_flags = 2;
+        } else {
+            level_flags = 3;
+        }
+
+        u32 header = ((Z_DEFLATED + ((window_bits - 8) << 4)) << 8) | (level_flags << 6);
+        header += 31 - (header % 31);
+        dst[0] = (u8)(header >> 8);
+        dst[1] = (u8)(header);
+        dst += 2;
+
+        uLong checksum = adler32(0, 0, 0);
+
+        if (strip_index) {
+            strip_index->resize(4 + band_count * 4);
+            put_uint32_be(strip_index->getBuffer(), (u32)rows_per_band);
+        }
+
+        for (int i = 0; i < band_count; i++) {
+            if (strip_index) {
+                put_uint32_be(strip_index->getBuffer() + 4 + i * 4, (u32)(dst - stream.getBuffer()));
+            }
+
+            std::memcpy(dst, outputs[i].getBuffer(), outputs[i].getSize());
+            dst += outputs[i].getSize();
+
+            size_t band_size = std::min(deflate_task.bandSize, filtered_size - i * deflate_task.bandSize);
+            checksum = adler32_combine(checksum, checksums[i], (z_off_t)band_size);
+        }
+
+        put_uint32_be(dst, (u32)checksum);
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------
+    bool InflateRowsParallel(const u8* stream, int stream_size, const u8* strip_index, int index_size, u8* pixels, int width, int height, int bpp, bool verify_checksum)
+    {
+        if (!stream || !strip_index || !pixels || width <= 0 || height <= 0 || bpp <= 0) {
+            return false;
+        }
+
+        // zlib header without a preset dictionary, plus the trailer
+        if (stream_size < 2 + 4 || (stream[0] & 0x0F) != Z_DEFLATED ||
+            ((stream[0] << 8) | stream[1]) % 31 != 0 || (stream[1] & 0x20) != 0)
+        {
+            return false;
+        }
+
+        if (index_size < 8 || index_size % 4 != 0) {
+            return false;
+        }
+
+        int rows_per_band = (int)std::min(get_uint32_be(strip_index), (u32)height);
+        int band_count = (index_size - 4) / 4;
+
+        if (rows_per_band <= 0 || band_count != (height + rows_per_band - 1) / rows_per_band) {
+            return false;
+        }
+
+        // the bands must follow each other, the first right after the header
+        ArrayAutoPtr<u32> offsets = new u32[band_count + 1];
+
+        for (int i = 0; i < band_count; i++) {
+            offsets[i] = get_uint32_be(strip_index + 4 + i * 4);
+        }
+        offsets[band_count] = (u32)(stream_size - 4);
+
+        if (offsets[0] != 2) {
+            return false;
+        }
+
+        for (int i = 0; i < band_count; i++) {
+            if (offsets[i] >= offsets[i + 1]) {
+                return false;
+            }
+        }
+
+        ArrayAutoPtr<uLong> checksums = new uLong[band_count];
+        ArrayAutoPtr<bool> failed = new bool[band_count];
+        std::fill(failed.get(), failed.get() + band_count, false);
+
+        InflateBandsTask task;
+        task.stream      = stream;
+        task.offsets     = offsets.get();
+        task.rowsPerBand = rows_per_band;
+        task.height      = height;
+        task.pitch       = width * bpp;
+        task.bpp         = bpp;
+        task.pixels      = pixels;
+        task.verify      = verify_checksum;
+        task.checksums   = checksums.get();
+        task.failed      = failed.get();
+        RunParallel(task, band_count);
+
+        for (int i = 0; i < band_count; i++) {
+            if (failed[i]) {
+                return false;
+            }
+        }
+
+        if (!verify_checksum) {
+            return true;
+        }
+
+        uLong checksum = adler32(0, 0, 0);
+
+        for (int i = 0; i < band_count; i++) {
+            int rows = std::min(rows_per_band, height - i * rows_per_band);
+            checksum = adler32_combine(checksum, checksums[i], (z_off_t)rows * (task.pitch + 1));
+        }
+
+        return (u32)checksum == get_uint32_be(stream + stream_size - 4);
+    }
+
+}
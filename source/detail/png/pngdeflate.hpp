@@ -0,0 +1,62 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_PNGDEFLATE_HPP_INCLUDED
+#define AZURA_PNGDEFLATE_HPP_INCLUDED
+
+#include "../../options.hpp"
+#include "../../types.hpp"
+#include "../ByteArray.hpp"
+
+
+// private chunk that lists where each band starts, written in front of
+// the image data when the bands are compressed independently: the rows
+// per band followed by the offset of every band in the zlib stream, all
+// as 32 bit big endian values; other readers skip the chunk, and editors
+// that don't know it drop it, as its name marks it unsafe to copy
+#define AZURA_PNG_STRIP_INDEX "azIX"
+
+
+namespace azura {
+
+    // filters the rows of an 8 bit image and compresses them into a
+    // complete zlib stream the way pigz does: bands of rows are deflated
+    // independently on the worker threads, each one primed with the last
+    // 32 KB of the band before it and ended with a sync flush, and the
+    // pieces are joined under a combined Adler-32; the band size doesn't
+    // depend on the thread count, so neither does the output; if
+    // strip_index is given, the bands don't depend on each other at all,
+    // they end with a full flush and their first row is filtered with none
+    // or sub only, and strip_index receives the contents of the azIX chunk
+    bool DeflateRowsParallel(const u8* pixels, int width, int height, int bpp, bool palettized, const PngWriteOptions& options, ByteArray& stream, ByteArray* strip_index = 0);
+
+    // counterpart of DeflateRowsParallel() for streams with a strip index:
+    // inflates and unfilters the bands concurrently, straight into pixels;
+    // the Adler-32 of the stream is only computed if verify_checksum is set
+    bool InflateRowsParallel(const u8* stream, int stream_size, const u8* strip_index, int index_size, u8* pixels, int width, int height, int bpp, bool verify_checksum = true);
+
+}
+
+
+#endif
@@ -0,0 +1,631 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "../../platform.hpp"
+#include "../ArrayAutoPtr.hpp"
+#include "pngfast.hpp"
+#include "pngfilter.hpp"
+
+#define BLOCK_SIZE      (1 << 20) /* filtered bytes per deflate block, at least one row */
+#define MIN_RUN         4         /* shorter runs are cheaper as literals */
+#define MAX_RUN         258
+#define MAX_CODE_LENGTH 15
+#define MAX_CLEN_LENGTH 7         /* for the code length code */
+#define FAST_FILTER     PngFilterType::Paeth
+
+
+namespace azura {
+
+    namespace {
+
+        const u16 LengthBase[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+
+        const u8 LengthExtra[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+        };
+
+        const u8 CodeLengthOrder[19] = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+        };
+
+        struct sym_freq {
+            u32 key;
+            u16 sym;
+        };
+
+        inline bool sym_freq_less(const sym_freq& a, const sym_freq& b)
+        {
+            return (a.key != b.key ? a.key < b.key : a.sym < b.sym);
+        }
+
+        // Moffat and Katajainen's in-place calculation of minimum
+        // redundancy code lengths; a is sorted by ascending frequency
+        // and receives the code lengths in the same order
+        void calculate_minimum_redundancy(sym_freq* a, int n)
+        {
+            if (n == 1) {
+                a[0].key = 1;
+                return;
+            }
+
+            a[0].key += a[1].key;
+            int root = 0;
+            int leaf = 2;
+
+            for (int next = 1; next < n - 1; next++) {
+                if (leaf >= n || a[root].key < a[leaf].key) {
+                    a[next].key = a[root].key;
+                    a[root++].key = next;
+                } else {
+                    a[next].key = a[leaf++].key;
+                }
+
+                if (leaf >= n || (root < next && a[root].key < a[leaf].key)) {
+                    a[next].key += a[root].key;
+                    a[root++].key = next;
+                } else {
+                    a[next].key += a[leaf++].key;
+                }
+            }
+
+            a[n - 2].key = 0;
+            for (int next = n - 3; next >= 0; next--) {
+                a[next].key = a[a[next].key].key + 1;
+            }
+
+            int avbl = 1;
+            int used = 0;
+            int depth = 0;
+            root = n - 2;
+            int next = n - 1;
+
+            while (avbl > 0) {
+                while (root >= 0 && (int)a[root].key == depth) {
+                    used++;
+                    root--;
+                }
+                while (avbl > used) {
+                    a[next--].key = depth;
+                    avbl--;
+                }
+                avbl = 2 * used;
+                depth++;
+                used = 0;
+            }
+        }
+
+        // computes huffman code lengths of at most max_length bits
+        void build_code_lengths(const u32* freqs, int count, int max_length, u8* lengths)
+        {
+            sym_freq syms[288];
+            int n = 0;
+
+            for (int i = 0; i < count; i++) {
+                if (freqs[i]) {
+                    syms[n].key = freqs[i];
+                    syms[n].sym = (u16)i;
+                    n++;
+                }
+            }
+
+            // a table with a single code is incomplete, which not all
+            // decoders accept, so pad it with an unused one
+            for (int i = 0; n < 2 && i < count; i++) {
+                if (!freqs[i]) {
+                    syms[n].key = 1;
+                    syms[n].sym = (u16)i;
+                    n++;
+                }
+            }
+
+            std::sort(syms, syms + n, sym_freq_less);
+            calculate_minimum_redundancy(syms, n);
+
+            int num_codes[33] = { 0 };
+            for (int i = 0; i < n; i++) {
+                num_codes[std::min(syms[i].key, (u32)32)]++;
+            }
+
+            // move the codes that are too long up and fix the kraft sum
+            for (int i = max_length + 1; i <= 32; i++) {
+                num_codes[max_length] += num_codes[i];
+            }
+
+            u32 total = 0;
+            for (int i = max_length; i > 0; i--) {
+                total += (u32)num_codes[i] << (max_length - i);
+            }
+
+            while (total != (1u << max_length)) {
+                num_codes[max_length]--;
+                for (int i = max_length - 1; i > 0; i--) {
+                    if (num_codes[i]) {
+                        num_codes[i]--;
+                        num_codes[i + 1] += 2;
+                        break;
+                    }
+                }
+                total--;
+            }
+
+            // the most frequent symbols get the shortest codes
+            std::memset(lengths, 0, count);
+            for (int len = 1, j = n; len <= max_length; len++) {
+                for (int k = num_codes[len]; k > 0; k--) {
+                    lengths[syms[--j].sym] = (u8)len;
+                }
+            }
+        }
+
+        // canonical codes, bit reversed as deflate writes them lsb first
+        void build_codes(const u8* lengths, int count, u16* codes)
+        {
+            int bl_count[MAX_CODE_LENGTH + 1] = { 0 };
+            for (int i = 0; i < count; i++) {
+                bl_count[lengths[i]]++;
+            }
+            bl_count[0] = 0;
+
+            u32 next_code[MAX_CODE_LENGTH + 1];
+            u32 code = 0;
+            for (int bits = 1; bits <= MAX_CODE_LENGTH; bits++) {
+                code = (code + bl_count[bits - 1]) << 1;
+                next_code[bits] = code;
+            }
+
+            for (int i = 0; i < count; i++) {
+                int len = lengths[i];
+                if (len) {
+                    u32 c = next_code[len]++;
+                    u32 r = 0;
+                    for (int b = 0; b < len; b++) {
+                        r = (r << 1) | ((c >> b) & 1);
+                    }
+                    codes[i] = (u16)r;
+                } else {
+                    codes[i] = 0;
+                }
+            }
+        }
+
+        class bit_writer {
+        public:
+            bit_writer(u8* dst) : _dst(dst), _bits(0), _count(0) {
+            }
+
+            // n must not exceed 56; stores 8 bytes at a time, so the
+            // output needs that much room beyond its end
+            void put(u64 value, int n) {
+                _bits |= value << _count;
+                _count += n;
+
+#if defined(AZURA_LITTLE_ENDIAN)
+                std::memcpy(_dst, &_bits, 8);
+#else
+                for (int i = 0; i < 8; i++) {
+                    _dst[i] = (u8)(_bits >> (i * 8));
+                }
+#endif
+
+                int bytes = _count >> 3;
+                _dst += bytes;
+                _bits >>= bytes * 8;
+                _count &= 7;
+            }
+
+            // pads with zero bits up to the next byte boundary
+            void align() {
+                if (_count > 0) {
+                    *_dst++ = (u8)_bits;
+                }
+                _bits = 0;
+                _count = 0;
+            }
+
+            // only on a byte boundary
+            void putBytes(const u8* src, int size) {
+                std::memcpy(_dst, src, size);
+                _dst += size;
+            }
+
+            u8* getPosition() const {
+                return _dst;
+            }
+
+        private:
+            u8* _dst;
+            u64 _bits;
+            int _count;
+        };
+
+        struct run {
+            int pos;
+            int length;
+        };
+
+        // finds the runs of at least MIN_RUN bytes that repeat the byte
+        // one pixel back, starting the search at begin; data[-bpp] to
+        // data[-1] must be readable if begin is 0
+        int find_runs(const u8* data, int size, int bpp, int begin, run* runs)
+        {
+            int count = 0;
+            int i = begin;
+
+            while (i < size) {
+                if (i + 8 <= size) {
+                    u64 a, b;
+                    std::memcpy(&a, data + i, 8);
+                    std::memcpy(&b, data + i - bpp, 8);
+                    u64 x = a ^ b;
+
+                    // 0x80 in every byte that matches, then in every byte
+                    // that starts four matches in a row (MIN_RUN); that
+                    // doesn't depend on the byte order, and if there are
+                    // none, no run starts in the first five bytes
+                    u64 z = ~(((x & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | x | 0x7F7F7F7F7F7F7F7FULL);
+                    if ((z & (z >> 8) & (z >> 16) & (z >> 24)) == 0) {
+                        i += 5;
+                        continue;
+                    }
+                }
+
+                if (data[i] != data[i - bpp]) {
+                    i++;
+                    continue;
+                }
+
+                int max = std::min(MAX_RUN, size - i);
+                int len = 1;
+
+                while (len + 8 <= max) {
+                    u64 a, b;
+                    std::memcpy(&a, data + i + len, 8);
+                    std::memcpy(&b, data + i + len - bpp, 8);
+                    if (a != b) {
+                        break;
+                    }
+                    len += 8;
+                }
+
+                while (len < max && data[i + len] == data[i + len - bpp]) {
+                    len++;
+                }
+
+                // the tail of a short run can't start a longer one
+                if (len >= MIN_RUN) {
+                    runs[count].pos = i;
+                    runs[count].length = len;
+                    count++;
+                }
+                i += len;
+            }
+
+            return count;
+        }
+
+        // adds the byte frequencies of data to four sets of counters,
+        // so that repeated bytes don't stall on the same counter
+        void count_literals(const u8* data, int size, u32 counts[4][256])
+        {
+            int i = 0;
+            for (; i + 4 <= size; i += 4) {
+                counts[0][data[i + 0]]++;
+                counts[1][data[i + 1]]++;
+                counts[2][data[i + 2]]++;
+                counts[3][data[i + 3]]++;
+            }
+            for (; i < size; i++) {
+                counts[0][data[i]]++;
+            }
+        }
+
+        // writes one block with its own huffman tables, or stored if
+        // that comes out smaller
+        void write_block(const u8* data, int size, const run* runs, int run_count, int bpp, bool last, const u8* length_syms, bit_writer& out)
+        {
+            u32 lit_freqs[286] = { 0 };
+            u32 dist_freqs[30] = { 0 };
+
+            // runs always go back exactly one pixel
+            int dist_sym = bpp - 1;
+
+            u32 counts[4][256];
+            std::memset(counts, 0, sizeof(counts));
+
+            int pos = 0;
+            for (int i = 0; i < run_count; i++) {
+                count_literals(data + pos, runs[i].pos - pos, counts);
+                lit_freqs[257 + length_syms[runs[i].length]]++;
+                pos = runs[i].pos + runs[i].length;
+            }
+            count_literals(data + pos, size - pos, counts);
+
+            for (int i = 0; i < 256; i++) {
+                lit_freqs[i] = counts[0][i] + counts[1][i] + counts[2][i] + counts[3][i];
+            }
+
+            dist_freqs[dist_sym] = run_count;
+            lit_freqs[256] = 1; /* end of block */
+
+            u8 lit_lengths[286];
+            u8 dist_lengths[30];
+            build_code_lengths(lit_freqs, 286, MAX_CODE_LENGTH, lit_lengths);
+            build_code_lengths(dist_freqs, 30, MAX_CODE_LENGTH, dist_lengths);
+
+            int hlit = 286;
+            while (hlit > 257 && !lit_lengths[hlit - 1]) {
+                hlit--;
+            }
+            int hdist = 30;
+            while (hdist > 1 && !dist_lengths[hdist - 1]) {
+                hdist--;
+            }
+
+            // run length encode both sets of code lengths
+            u8 all_lengths[286 + 30];
+            std::memcpy(all_lengths, lit_lengths, hlit);
+            std::memcpy(all_lengths + hlit, dist_lengths, hdist);
+            int all_count = hlit + hdist;
+
+            u8 clen_syms[286 + 30];
+            u8 clen_extra[286 + 30];
+            int clen_count = 0;
+            u32 clen_freqs[19] = { 0 };
+
+            for (int i = 0; i < all_count; ) {
+                int value = all_lengths[i];
+                int run = 1;
+                while (i + run < all_count && all_lengths[i + run] == value) {
+                    run++;
+                }
+                i += run;
+
+                if (value == 0) {
+                    while (run >= 11) {
+                        int n = std::min(run, 138);
+                        clen_syms[clen_count] = 18;
+                        clen_extra[clen_count++] = (u8)(n - 11);
+                        run -= n;
+                    }
+                    if (run >= 3) {
+                        clen_syms[clen_count] = 17;
+                        clen_extra[clen_count++] = (u8)(run - 3);
+                        run = 0;
+                    }
+                } else {
+                    clen_syms[clen_count] = (u8)value;
+                    clen_extra[clen_count++] = 0;
+                    run--;
+                    while (run >= 3) {
+                        int n = std::min(run, 6);
+                        clen_syms[clen_count] = 16;
+                        clen_extra[clen_count++] = (u8)(n - 3);
+                        run -= n;
+                    }
+                }
+
+                while (run-- > 0) {
+                    clen_syms[clen_count] = (u8)value;
+                    clen_extra[clen_count++] = 0;
+                }
+            }
+
+            for (int i = 0; i < clen_count; i++) {
+                clen_freqs[clen_syms[i]]++;
+            }
+
+            u8 clen_lengths[19];
+            build_code_lengths(clen_freqs, 19, MAX_CLEN_LENGTH, clen_lengths);
+
+            int hclen = 19;
+            while (hclen > 4 && !clen_lengths[CodeLengthOrder[hclen - 1]]) {
+                hclen--;
+            }
+
+            // size of the compressed block in bits
+            static const int clen_extra_bits[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+            u64 bits = 3 + 5 + 5 + 4 + 3 * hclen;
+            for (int i = 0; i < 19; i++) {
+                bits += (u64)clen_freqs[i] * (clen_lengths[i] + clen_extra_bits[i]);
+            }
+            for (int i = 0; i < 256; i++) {
+                bits += (u64)lit_freqs[i] * lit_lengths[i];
+            }
+            bits += lit_lengths[256];
+            for (int i = 0; i < 29; i++) {
+                bits += (u64)lit_freqs[257 + i] * (lit_lengths[257 + i] + LengthExtra[i]);
+            }
+            bits += (u64)dist_freqs[dist_sym] * dist_lengths[dist_sym];
+
+            u64 stored_bits = ((u64)size + 5 * (size / 65535 + 1)) * 8;
+
+            if (bits >= stored_bits) {
+                int pos = 0;
+                do {
+                    int n = std::min(65535, size - pos);
+                    bool final = last && (pos + n == size);
+                    out.put(final ? 1 : 0, 3);
+                    out.align();
+                    out.put((u32)n | ((u32)(~n & 0xFFFF) << 16), 32);
+                    out.putBytes(data + pos, n);
+                    pos += n;
+                } while (pos < size);
+                return;
+            }
+
+            u16 lit_codes[286];
+            u16 dist_codes[30];
+            u16 clen_codes[19];
+            build_codes(lit_lengths, 286, lit_codes);
+            build_codes(dist_lengths, 30, dist_codes);
+            build_codes(clen_lengths, 19, clen_codes);
+
+            out.put(last ? 1 : 0, 1);
+            out.put(2, 2); /* dynamic huffman codes */
+            out.put(hlit - 257, 5);
+            out.put(hdist - 1, 5);
+            out.put(hclen - 4, 4);
+
+            for (int i = 0; i < hclen; i++) {
+                out.put(clen_lengths[CodeLengthOrder[i]], 3);
+            }
+
+            for (int i = 0; i < clen_count; i++) {
+                int s = clen_syms[i];
+                out.put(clen_codes[s], clen_lengths[s]);
+                if (clen_extra_bits[s]) {
+                    out.put(clen_extra[i], clen_extra_bits[s]);
+                }
+            }
+
+            // runs are written at once: length code, extra bits and
+            // distance code combined
+            u64 run_codes[MAX_RUN + 1];
+            u8 run_bits[MAX_RUN + 1];
+
+            for (int len = MIN_RUN; len <= MAX_RUN; len++) {
+                int s = length_syms[len];
+                int bits = lit_lengths[257 + s];
+                u64 code = lit_codes[257 + s];
+                code |= (u64)(len - LengthBase[s]) << bits;
+                bits += LengthExtra[s];
+                code |= (u64)dist_codes[dist_sym] << bits;
+                bits += dist_lengths[dist_sym];
+                run_codes[len] = code;
+                run_bits[len] = (u8)bits;
+            }
+
+            pos = 0;
+            for (int i = 0; i <= run_count; i++) {
+                int end = (i < run_count ? runs[i].pos : size);
+
+                // up to three literals fit into one write
+                for (; pos + 3 <= end; pos += 3) {
+                    int b0 = data[pos];
+                    int b1 = data[pos + 1];
+                    int b2 = data[pos + 2];
+                    u64 code = lit_codes[b0]
+                             | ((u64)lit_codes[b1] << lit_lengths[b0])
+                             | ((u64)lit_codes[b2] << (lit_lengths[b0] + lit_lengths[b1]));
+                    out.put(code, lit_lengths[b0] + lit_lengths[b1] + lit_lengths[b2]);
+                }
+                for (; pos < end; pos++) {
+                    out.put(lit_codes[data[pos]], lit_lengths[data[pos]]);
+                }
+
+                if (i < run_count) {
+                    out.put(run_codes[runs[i].length], run_bits[runs[i].length]);
+                    pos += runs[i].length;
+                }
+            }
+
+            out.put(lit_codes[256], lit_lengths[256]);
+        }
+
+    }
+
+    //-----------------------------------------------------------------
+    bool DeflateRowsFast(const u8* pixels, int width, int height, int bpp, bool palettized, ByteArray& stream)
+    {
+        if (!pixels || width <= 0 || height <= 0 || bpp <= 0 || bpp > 4) {
+            return false;
+        }
+
+        int pitch = width * bpp;
+        PngFilterType::Enum filter = (palettized ? PngFilterType::None : FAST_FILTER);
+
+        int rows_per_block = std::min(std::max(BLOCK_SIZE / (pitch + 1), 1), height);
+        int block_size = rows_per_block * (pitch + 1);
+        int block_count = (height + rows_per_block - 1) / rows_per_block;
+
+        // worst case is every block stored
+        size_t bound = 2 + 4 + 16 + (size_t)block_count * (block_size + 5 * (block_size / 65535 + 1) + 1);
+        if (bound > 0x7FFFFFFF) {
+            return false;
+        }
+        stream.resize((int)bound);
+
+        u8 length_syms[MAX_RUN + 1];
+        for (int s = 0; s < 29; s++) {
+            int end = (s < 28 ? LengthBase[s + 1] : MAX_RUN + 1);
+            for (int len = LengthBase[s]; len < end; len++) {
+                length_syms[len] = (u8)s;
+            }
+        }
+
+        // the last pixel of the previous block goes in front
+        ArrayAutoPtr<u8> buffer = new u8[bpp + block_size];
+        ArrayAutoPtr<run> runs = new run[block_size / MIN_RUN + 1];
+        u8* data = buffer.get() + bpp;
+
+        u8* dst = stream.getBuffer();
+        dst[0] = 0x78; /* deflate with a 32K window */
+        dst[1] = 0x01; /* fastest compression, no dictionary */
+
+        bit_writer out(dst + 2);
+        uLong checksum = adler32(0, 0, 0);
+
+        for (int block = 0; block < block_count; block++) {
+            int begin = block * rows_per_block;
+            int end = std::min(begin + rows_per_block, height);
+            int size = (end - begin) * (pitch + 1);
+
+            for (int y = begin; y < end; y++) {
+                const u8* row = pixels + (size_t)y * pitch;
+                u8* filtered = data + (y - begin) * (pitch + 1);
+                filtered[0] = (u8)filter;
+                FilterRow(filter, row, (y > 0 ? row - pitch : 0), pitch, bpp, filtered + 1);
+            }
+
+            checksum = adler32(checksum, data, size);
+
+            int run_count = find_runs(data, size, bpp, (block == 0 ? bpp : 0), runs.get());
+            write_block(data, size, runs.get(), run_count, bpp, block == block_count - 1, length_syms, out);
+
+            std::memcpy(buffer.get(), data + size - bpp, bpp);
+        }
+
+        out.align();
+        dst = out.getPosition();
+        dst[0] = (u8)(checksum >> 24);
+        dst[1] = (u8)(checksum >> 16);
+        dst[2] = (u8)(checksum >> 8);
+        dst[3] = (u8)(checksum);
+        dst += 4;
+
+        stream.resize((int)(dst - stream.getBuffer()));
+
+        return true;
+    }
+
+}
@@ -0,0 +1,43 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_PNGFAST_HPP_INCLUDED
+#define AZURA_PNGFAST_HPP_INCLUDED
+
+#include "../../types.hpp"
+#include "../ByteArray.hpp"
+
+
+namespace azura {
+
+    // filters the rows of an 8 bit image with one fixed filter and
+    // compresses them into a complete zlib stream with a deflate that
+    // only looks for runs of repeated pixels; much faster than zlib at
+    // any level, at the price of somewhat larger files
+    bool DeflateRowsFast(const u8* pixels, int width, int height, int bpp, bool palettized, ByteArray& stream);
+
+}
+
+
+#endif
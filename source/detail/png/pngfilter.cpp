@@ -0,0 +1,475 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "../../options.hpp"
+#include "../kernels.hpp"
+#include "pngfilter.hpp"
+
+#if defined(AZURA_X86)
+#    include <immintrin.h>
+#endif
+
+#define CHUNK_SIZE 256 /* bytes between the early exit checks */
+
+
+namespace azura {
+
+    namespace {
+
+        inline int paeth_predictor(int a, int b, int c)
+        {
+            int p  = a + b - c;
+            int pa = std::abs(p - a);
+            int pb = std::abs(p - b);
+            int pc = std::abs(p - c);
+
+            // written as selects, the outcome is too random for branches
+            int bc = (pb <= pc ? b : c);
+            return (pa <= pb && pa <= pc ? a : bc);
+        }
+
+        // the filtered bytes are taken as signed values, so that small
+        // negative differences count as small as well
+        inline u32 sum_abs_differences(const u8* data, int size, u32 limit)
+        {
+            u32 sum = 0;
+            for (int i = 0; i < size; i++) {
+                sum += (data[i] < 128 ? data[i] : 256 - data[i]);
+                if (sum > limit) {
+                    break;
+                }
+            }
+            return sum;
+        }
+
+        // filters the bytes from begin to end one by one, around the vector
+        // loops; prev must not be null
+        inline u32 filter_bytes(PngFilterType::Enum type, const u8* row, const u8* prev, int begin, int end, int bpp, u8* dst)
+        {
+            u32 sum = 0;
+            for (int i = begin; i < end; i++) {
+                int a = (i >= bpp ? row[i - bpp] : 0);
+                int b = prev[i];
+                int c = (i >= bpp ? prev[i - bpp] : 0);
+                int p = 0;
+                switch (type)
+                {
+                    case PngFilterType::Sub:     p = a; break;
+                    case PngFilterType::Up:      p = b; break;
+                    case PngFilterType::Average: p = (a + b) >> 1; break;
+                    case PngFilterType::Paeth:   p = paeth_predictor(a, b, c); break;
+                    default:                     break;
+                }
+                u8 d = (u8)(row[i] - p);
+                dst[i] = d;
+                sum += (d < 128 ? d : 256 - d);
+            }
+            return sum;
+        }
+
+    }
+
+    //-----------------------------------------------------------------
+    void FilterRow(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst)
+    {
+        GetKernels().filterRow(type, row, prev, size, bpp, dst, 0xFFFFFFFF);
+    }
+
+    //-----------------------------------------------------------------
+    u32 FilterRowScalar(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst, u32 limit)
+    {
+        if (!prev) {
+            // the row above the first one counts as zero
+            if (type == PngFilterType::Up) {
+                type = PngFilterType::None;
+            } else if (type == PngFilterType::Paeth) {
+                type = PngFilterType::Sub;
+            }
+        }
+
+        int i = 0;
+
+        switch (type)
+        {
+            case PngFilterType::Sub:
+                for (; i < bpp; i++) {
+                    dst[i] = row[i];
+                }
+                for (; i < size; i++) {
+                    dst[i] = (u8)(row[i] - row[i - bpp]);
+                }
+                break;
+
+            case PngFilterType::Up:
+                for (; i < size; i++) {
+                    dst[i] = (u8)(row[i] - prev[i]);
+                }
+                break;
+
+            case PngFilterType::Average:
+                if (prev) {
+                    for (; i < bpp; i++) {
+                        dst[i] = (u8)(row[i] - (prev[i] >> 1));
+                    }
+                    for (; i < size; i++) {
+                        dst[i] = (u8)(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+                    }
+                } else {
+                    for (; i < bpp; i++) {
+                        dst[i] = row[i];
+                    }
+                    for (; i < size; i++) {
+                        dst[i] = (u8)(row[i] - (row[i - bpp] >> 1));
+                    }
+                }
+                break;
+
+            case PngFilterType::Paeth:
+                for (; i < bpp; i++) {
+                    dst[i] = (u8)(row[i] - prev[i]);
+                }
+                for (; i < size; i++) {
+                    dst[i] = (u8)(row[i] - paeth_predictor(row[i - bpp], prev[i], prev[i - bpp]));
+                }
+                break;
+
+            default:
+                std::memcpy(dst, row, size);
+                break;
+        }
+
+        return sum_abs_differences(dst, size, limit);
+    }
+
+    //-----------------------------------------------------------------
+    bool UnfilterRow(int type, const u8* src, const u8* prev, int size, int bpp, u8* dst)
+    {
+        if (!prev) {
+            // the row above the first one counts as zero
+            if (type == PngFilterType::Up) {
+                type = PngFilterType::None;
+            } else if (type == PngFilterType::Paeth) {
+                type = PngFilterType::Sub;
+            }
+        }
+
+        int i = 0;
+
+        switch (type)
+        {
+            case PngFilterType::None:
+                std::memcpy(dst, src, size);
+                break;
+
+            case PngFilterType::Sub:
+                for (; i < bpp; i++) {
+                    dst[i] = src[i];
+                }
+                for (; i < size; i++) {
+                    dst[i] = (u8)(src[i] + dst[i - bpp]);
+                }
+                break;
+
+            case PngFilterType::Up:
+                for (; i < size; i++) {
+                    dst[i] = (u8)(src[i] + prev[i]);
+                }
+                break;
+
+            case PngFilterType::Average:
+                if (prev) {
+                    for (; i < bpp; i++) {
+                        dst[i] = (u8)(src[i] + (prev[i] >> 1));
+                    }
+                    for (; i < size; i++) {
+                        dst[i] = (u8)(src[i] + ((dst[i - bpp] + prev[i]) >> 1));
+                    }
+                } else {
+                    for (; i < bpp; i++) {
+                        dst[i] = src[i];
+                    }
+                    for (; i < size; i++) {
+                        dst[i] = (u8)(src[i] + (dst[i - bpp] >> 1));
+                    }
+                }
+                break;
+
+            case PngFilterType::Paeth:
+                for (; i < bpp; i++) {
+                    dst[i] = (u8)(src[i] + prev[i]);
+                }
+                for (; i < size; i++) {
+                    dst[i] = (u8)(src[i] + paeth_predictor(dst[i - bpp], prev[i], prev[i - bpp]));
+                }
+                break;
+
+            default:
+                return false;
+        }
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------
+    void FilterRowAdaptive(int filters, const u8* row, const u8* prev, int size, int bpp, u8* dst, u8* scratch)
+    {
+        FilterRowFunc filter_row = GetKernels().filterRow;
+
+        int best_type = -1;
+        u32 best_sum = 0xFFFFFFFF;
+
+        // the candidates alternate between both buffers, so that the best
+        // one so far is never copied, until it has won
+        u8* best = dst + 1;
+        u8* next = scratch;
+
+        for (int type = 0; type < PngFilterType::Count; type++) {
+            if (!(filters & (PngFilters::None << type))) {
+                continue;
+            }
+
+            u8* out = (best_type < 0 ? best : next);
+            u32 sum = filter_row((PngFilterType::Enum)type, row, prev, size, bpp, out, best_sum);
+
+            if (best_type < 0 || sum < best_sum) {
+                if (out != best) {
+                    next = best;
+                    best = out;
+                }
+                best_type = type;
+                best_sum = sum;
+            }
+        }
+
+        if (best_type < 0) {
+            // no filter allowed at all, store the row as it is
+            std::memcpy(dst + 1, row, size);
+            best_type = PngFilterType::None;
+        } else if (best != dst + 1) {
+            std::memcpy(dst + 1, best, size);
+        }
+
+        dst[0] = (u8)best_type;
+    }
+
+#if defined(AZURA_X86)
+
+    namespace {
+
+        AZURA_TARGET("sse2")
+        inline __m128i abs_diff_sse2(__m128i x, __m128i y)
+        {
+            return _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+        }
+
+        AZURA_TARGET("sse2")
+        inline __m128i less_equal_sse2(__m128i x, __m128i y)
+        {
+            return _mm_cmpeq_epi8(_mm_subs_epu8(x, y), _mm_setzero_si128());
+        }
+
+        AZURA_TARGET("sse2")
+        inline __m128i select_sse2(__m128i mask, __m128i x, __m128i y)
+        {
+            return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+        }
+
+        // paeth_predictor() on 16 bytes at once, without leaving 8 bits
+        AZURA_TARGET("sse2")
+        inline __m128i paeth_predictor_sse2(__m128i a, __m128i b, __m128i c)
+        {
+            __m128i pa = abs_diff_sse2(b, c);
+            __m128i pb = abs_diff_sse2(a, c);
+
+            // |a + b - 2c| adds up both distances if a and b are on the same
+            // side of c, and is their difference otherwise; saturating at 255
+            // doesn't change the outcome of any comparison below
+            __m128i same = _mm_cmpeq_epi8(less_equal_sse2(b, c), less_equal_sse2(a, c));
+            __m128i pc = select_sse2(same, _mm_adds_epu8(pa, pb), abs_diff_sse2(pa, pb));
+
+            __m128i use_a = _mm_and_si128(less_equal_sse2(pa, pb), less_equal_sse2(pa, pc));
+            return select_sse2(use_a, a, select_sse2(less_equal_sse2(pb, pc), b, c));
+        }
+
+        AZURA_TARGET("sse2")
+        inline __m128i predict_sse2(PngFilterType::Enum type, const u8* row, const u8* prev, int bpp)
+        {
+            switch (type)
+            {
+                case PngFilterType::Sub:
+                    return _mm_loadu_si128((const __m128i*)(row - bpp));
+
+                case PngFilterType::Up:
+                    return _mm_loadu_si128((const __m128i*)prev);
+
+                case PngFilterType::Average: {
+                    __m128i a = _mm_loadu_si128((const __m128i*)(row - bpp));
+                    __m128i b = _mm_loadu_si128((const __m128i*)prev);
+                    // _mm_avg_epu8() rounds up, libpng rounds down
+                    __m128i odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+                    return _mm_sub_epi8(_mm_avg_epu8(a, b), odd);
+                }
+
+                case PngFilterType::Paeth:
+                    return paeth_predictor_sse2(_mm_loadu_si128((const __m128i*)(row - bpp)),
+                                                _mm_loadu_si128((const __m128i*)prev),
+                                                _mm_loadu_si128((const __m128i*)(prev - bpp)));
+
+                default:
+                    return _mm_setzero_si128();
+            }
+        }
+
+        AZURA_TARGET("avx2")
+        inline __m256i abs_diff_avx2(__m256i x, __m256i y)
+        {
+            return _mm256_or_si256(_mm256_subs_epu8(x, y), _mm256_subs_epu8(y, x));
+        }
+
+        AZURA_TARGET("avx2")
+        inline __m256i less_equal_avx2(__m256i x, __m256i y)
+        {
+            return _mm256_cmpeq_epi8(_mm256_subs_epu8(x, y), _mm256_setzero_si256());
+        }
+
+        AZURA_TARGET("avx2")
+        inline __m256i paeth_predictor_avx2(__m256i a, __m256i b, __m256i c)
+        {
+            __m256i pa = abs_diff_avx2(b, c);
+            __m256i pb = abs_diff_avx2(a, c);
+
+            __m256i same = _mm256_cmpeq_epi8(less_equal_avx2(b, c), less_equal_avx2(a, c));
+            __m256i pc = _mm256_blendv_epi8(abs_diff_avx2(pa, pb), _mm256_adds_epu8(pa, pb), same);
+
+            __m256i use_a = _mm256_and_si256(less_equal_avx2(pa, pb), less_equal_avx2(pa, pc));
+            return _mm256_blendv_epi8(_mm256_blendv_epi8(c, b, less_equal_avx2(pb, pc)), a, use_a);
+        }
+
+        AZURA_TARGET("avx2")
+        inline __m256i predict_avx2(PngFilterType::Enum type, const u8* row, const u8* prev, int bpp)
+        {
+            switch (type)
+            {
+                case PngFilterType::Sub:
+                    return _mm256_loadu_si256((const __m256i*)(row - bpp));
+
+                case PngFilterType::Up:
+                    return _mm256_loadu_si256((const __m256i*)prev);
+
+                case PngFilterType::Average: {
+                    __m256i a = _mm256_loadu_si256((const __m256i*)(row - bpp));
+                    __m256i b = _mm256_loadu_si256((const __m256i*)prev);
+                    __m256i odd = _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1));
+                    return _mm256_sub_epi8(_mm256_avg_epu8(a, b), odd);
+                }
+
+                case PngFilterType::Paeth:
+                    return paeth_predictor_avx2(_mm256_loadu_si256((const __m256i*)(row - bpp)),
+                                                _mm256_loadu_si256((const __m256i*)prev),
+                                                _mm256_loadu_si256((const __m256i*)(prev - bpp)));
+
+                default:
+                    return _mm256_setzero_si256();
+            }
+        }
+
+    }
+
+    //-----------------------------------------------------------------
+    AZURA_TARGET("sse2")
+    u32 FilterRowSSE2(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst, u32 limit)
+    {
+        if (!prev) {
+            // only the first row of the image, not worth the trouble
+            return FilterRowScalar(type, row, prev, size, bpp, dst, limit);
+        }
+
+        // the first pixel has no left neighbour
+        int i = std::min(bpp, size);
+        u32 sum = filter_bytes(type, row, prev, 0, i, bpp, dst);
+
+        __m128i zero = _mm_setzero_si128();
+
+        while (i + 16 <= size) {
+            int end = std::min(i + CHUNK_SIZE, size);
+            __m128i acc = zero;
+
+            for (; i + 16 <= end; i += 16) {
+                __m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+                __m128i d = _mm_sub_epi8(x, predict_sse2(type, row + i, prev + i, bpp));
+                _mm_storeu_si128((__m128i*)(dst + i), d);
+                // the smaller one of d and -d is |d| for d taken as signed
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_min_epu8(d, _mm_sub_epi8(zero, d)), zero));
+            }
+
+            sum += (u32)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+            if (sum > limit) {
+                return sum;
+            }
+        }
+
+        return sum + filter_bytes(type, row, prev, i, size, bpp, dst);
+    }
+
+    //-----------------------------------------------------------------
+    AZURA_TARGET("avx2")
+    u32 FilterRowAVX2(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst, u32 limit)
+    {
+        if (!prev) {
+            return FilterRowScalar(type, row, prev, size, bpp, dst, limit);
+        }
+
+        int i = std::min(bpp, size);
+        u32 sum = filter_bytes(type, row, prev, 0, i, bpp, dst);
+
+        __m256i zero = _mm256_setzero_si256();
+
+        while (i + 32 <= size) {
+            int end = std::min(i + CHUNK_SIZE, size);
+            __m256i acc = zero;
+
+            for (; i + 32 <= end; i += 32) {
+                __m256i x = _mm256_loadu_si256((const __m256i*)(row + i));
+                __m256i d = _mm256_sub_epi8(x, predict_avx2(type, row + i, prev + i, bpp));
+                _mm256_storeu_si256((__m256i*)(dst + i), d);
+                acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_min_epu8(d, _mm256_sub_epi8(zero, d)), zero));
+            }
+
+            __m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            sum += (u32)(_mm_cvtsi128_si32(acc128) + _mm_cvtsi128_si32(_mm_srli_si128(acc128, 8)));
+            if (sum > limit) {
+                return sum;
+            }
+        }
+
+        return sum + filter_bytes(type, row, prev, i, size, bpp, dst);
+    }
+
+#endif
+
+}
@@ -0,0 +1,73 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_PNGFILTER_HPP_INCLUDED
+#define AZURA_PNGFILTER_HPP_INCLUDED
+
+#include "../../types.hpp"
+#include "../cpu.hpp"
+
+
+namespace azura {
+
+    // row filter types, as stored in front of every row of the image data
+    struct PngFilterType {
+        enum Enum {
+            None    = 0,
+            Sub     = 1,
+            Up      = 2,
+            Average = 3,
+            Paeth   = 4,
+            Count,
+        };
+    };
+
+    // filters size bytes of row into dst; prev is the unfiltered
+    // previous row, or null for the first row of the image
+    void FilterRow(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst);
+
+    // FilterRow() kernels, which also return the sum of absolute differences
+    // of the filtered bytes; once the sum exceeds limit they may stop early
+    // and return any value above limit, leaving dst partially written
+    u32 FilterRowScalar(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst, u32 limit);
+
+#if defined(AZURA_X86)
+    u32 FilterRowSSE2(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst, u32 limit);
+    u32 FilterRowAVX2(PngFilterType::Enum type, const u8* row, const u8* prev, int size, int bpp, u8* dst, u32 limit);
+#endif
+
+    // reverses FilterRow(), prev being the unfiltered previous row or null
+    // again; returns false for unknown filter types
+    bool UnfilterRow(int type, const u8* src, const u8* prev, int size, int bpp, u8* dst);
+
+    // picks the filter out of the allowed PngFilters flags that gives the
+    // smallest sum of absolute differences, like libpng does; writes the
+    // filter type byte followed by the filtered row to dst, scratch must
+    // hold size bytes
+    void FilterRowAdaptive(int filters, const u8* row, const u8* prev, int size, int bpp, u8* dst, u8* scratch);
+
+}
+
+
+#endif
@@ -0,0 +1,473 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <png.h>
+
+#include "../ArrayAutoPtr.hpp"
+#include "../kernels.hpp"
+#include "pngreduce.hpp"
+
+#if defined(AZURA_X86)
+#    include <immintrin.h>
+#endif
+
+#define CHUNK_SIZE 256  /* pixels between the early exit checks */
+#define TABLE_SIZE 1024 /* hash table slots, four times the palette size */
+
+
+namespace azura {
+
+    namespace {
+
+        // the distinct colors of an image, as long as they fit into a palette
+        struct color_table {
+            u32 keys[TABLE_SIZE];
+            u8  used[TABLE_SIZE];
+            u8  indices[TABLE_SIZE];
+            int count;
+
+            color_table()
+                : count(0)
+            {
+                std::memset(used, 0, sizeof(used));
+            }
+
+            int find(u32 key) const
+            {
+                int slot = (int)((key * 2654435761u) >> 22);
+                while (used[slot] && keys[slot] != key) {
+                    slot = (slot + 1) & (TABLE_SIZE - 1);
+                }
+                return slot;
+            }
+
+            // returns false once there are more colors than palette entries
+            bool add(u32 key)
+            {
+                int slot = find(key);
+                if (!used[slot]) {
+                    if (count == 256) {
+                        return false;
+                    }
+                    used[slot] = 1;
+                    keys[slot] = key;
+                    count++;
+                }
+                return true;
+            }
+        };
+
+        inline u32 pack_key(const u8* pixel, int bpp)
+        {
+            u32 alpha = (bpp == 4 ? pixel[3] : 255);
+            return pixel[0] | ((u32)pixel[1] << 8) | ((u32)pixel[2] << 16) | (alpha << 24);
+        }
+
+        bool add_colors(color_table& table, const u8* src, int bpp, int count)
+        {
+            u32 last_key = pack_key(src, bpp);
+            if (!table.add(last_key)) {
+                return false;
+            }
+
+            for (int i = 1; i < count; i++) {
+                src += bpp;
+                u32 key = pack_key(src, bpp);
+                if (key != last_key) {
+                    if (!table.add(key)) {
+                        return false;
+                    }
+                    last_key = key;
+                }
+            }
+
+            return true;
+        }
+
+        int bit_depth_for(int color_count)
+        {
+            return (color_count <= 2 ? 1 : color_count <= 4 ? 2 : color_count <= 16 ? 4 : 8);
+        }
+
+        // the smallest bit depth that represents all gray levels exactly,
+        // when scaled up by bit replication the way decoders do
+        int gray_bit_depth(const color_table& table)
+        {
+            int depth = 1;
+
+            for (int i = 0; i < TABLE_SIZE; i++) {
+                if (table.used[i]) {
+                    u8 level = (u8)table.keys[i];
+                    while (depth < 8 && level % (255 / ((1 << depth) - 1)) != 0) {
+                        depth *= 2;
+                    }
+                }
+            }
+
+            return depth;
+        }
+
+        // packs samples of below 8 bits into bytes, leftmost sample first
+        void pack_row(const u8* samples, int count, int depth, u8* dst)
+        {
+            if (depth == 8) {
+                std::memcpy(dst, samples, count);
+                return;
+            }
+
+            int per_byte = 8 / depth;
+
+            for (int i = 0; i < count; i += per_byte) {
+                int n = std::min(per_byte, count - i);
+                u32 byte = 0;
+                for (int j = 0; j < n; j++) {
+                    byte |= (u32)samples[i + j] << (8 - depth * (j + 1));
+                }
+                *dst++ = (u8)byte;
+            }
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    bool ReduceColorType(Image* image, bool parallel_readable, PngReducedImage& reduced)
+    {
+        PixelFormat::Enum pf = image->getPixelFormat();
+
+        if (pf != PixelFormat::RGB && pf != PixelFormat::RGBA && pf != PixelFormat::RGB_P8 && pf != PixelFormat::RGBA_P8) {
+            return false;
+        }
+
+        int width  = image->getWidth();
+        int height = image->getHeight();
+        const u8* pixels = image->getPixels();
+
+        PixelFormatDescriptor pfd = Image::GetPixelFormatDescriptor(pf);
+
+        // the traits that would allow a smaller color type
+        int wanted = (parallel_readable ? 0 : PixelTraits::Gray);
+        if (pfd.hasAlpha) {
+            wanted |= PixelTraits::Opaque;
+        }
+
+        // gather the distinct colors and the traits shared by all pixels
+        color_table colors;
+        RGBA entries[256];
+        int traits = wanted;
+        bool few_colors = true;
+
+        if (pfd.isDirectColor) {
+            const Kernels& kernels = GetKernels();
+            int bpp = pfd.bytesPerPixel;
+
+            for (int y = 0; y < height; y++) {
+                const u8* row = pixels + (size_t)y * width * bpp;
+
+                traits = kernels.classifyPixels(row, bpp, width, traits);
+
+                if (few_colors) {
+                    few_colors = add_colors(colors, row, bpp, width);
+                }
+
+                if (!few_colors && traits == 0) {
+                    // nothing left to gain from the remaining rows
+                    return false;
+                }
+            }
+        } else {
+            bool used[256] = { false };
+            for (size_t i = 0; i < (size_t)width * height; i++) {
+                used[pixels[i]] = true;
+            }
+
+            const RGB* plt = image->getPalette();
+            const RGBA* alpha_plt = image->getAlphaPalette();
+
+            for (int i = 0; i < 256; i++) {
+                if (pfd.hasAlpha) {
+                    entries[i] = alpha_plt[i];
+                } else {
+                    entries[i].red   = plt[i].red;
+                    entries[i].green = plt[i].green;
+                    entries[i].blue  = plt[i].blue;
+                    entries[i].alpha = 255;
+                }
+                if (used[i]) {
+                    colors.add(pack_key((const u8*)(entries + i), 4));
+                    traits = ClassifyPixelsScalar((const u8*)(entries + i), 4, 1, traits);
+                }
+            }
+        }
+
+        // pick the representation with the fewest bits per pixel; gray
+        // levels don't need a palette on ties, and direct gray with alpha
+        // beats an 8 bit palette because it still compresses well filtered
+        bool gray   = (traits & PixelTraits::Gray) != 0;
+        bool opaque = !pfd.hasAlpha || (traits & PixelTraits::Opaque) != 0;
+
+        int palette_depth = (parallel_readable ? 8 : bit_depth_for(colors.count));
+
+        if (gray && opaque && gray_bit_depth(colors) <= palette_depth) {
+            reduced.colorType = PNG_COLOR_TYPE_GRAY;
+            reduced.bitDepth = gray_bit_depth(colors);
+        } else if (few_colors && !(gray && palette_depth == 8 && pfd.isDirectColor)) {
+            reduced.colorType = PNG_COLOR_TYPE_PALETTE;
+            reduced.bitDepth = palette_depth;
+        } else if (gray) {
+            reduced.colorType = PNG_COLOR_TYPE_GRAY_ALPHA;
+            reduced.bitDepth = 8;
+        } else if (opaque && pfd.hasAlpha) {
+            reduced.colorType = PNG_COLOR_TYPE_RGB;
+            reduced.bitDepth = 8;
+        } else {
+            return false;
+        }
+
+        if (pf == PixelFormat::RGB_P8 && reduced.colorType == PNG_COLOR_TYPE_PALETTE && reduced.bitDepth == 8 && colors.count == 256) {
+            // already as small as it gets
+            return false;
+        }
+
+        int channels = (reduced.colorType == PNG_COLOR_TYPE_RGB ? 3 : reduced.colorType == PNG_COLOR_TYPE_GRAY_ALPHA ? 2 : 1);
+
+        reduced.pitch = (width * channels * reduced.bitDepth + 7) / 8;
+        reduced.bytesPerPixel = std::max(channels * reduced.bitDepth / 8, 1);
+        reduced.paletteSize = 0;
+        reduced.pixels.resize(reduced.pitch * height);
+
+        if (reduced.colorType == PNG_COLOR_TYPE_PALETTE) {
+            // the keys sort by alpha first, which puts the translucent
+            // entries at the front and keeps the tRNS chunk short
+            u32 keys[256];
+            for (int i = 0; i < TABLE_SIZE; i++) {
+                if (colors.used[i]) {
+                    keys[reduced.paletteSize++] = colors.keys[i];
+                }
+            }
+            std::sort(keys, keys + reduced.paletteSize);
+
+            for (int i = 0; i < reduced.paletteSize; i++) {
+                RGBA& entry = reduced.palette[i];
+                entry.red   = (u8)keys[i];
+                entry.green = (u8)(keys[i] >> 8);
+                entry.blue  = (u8)(keys[i] >> 16);
+                entry.alpha = (u8)(keys[i] >> 24);
+                colors.indices[colors.find(keys[i])] = (u8)i;
+            }
+        }
+
+        int shift = 8 - reduced.bitDepth;
+
+        if (!pfd.isDirectColor) {
+            // every old index translates to one new sample
+            u8 samples[256];
+            for (int i = 0; i < 256; i++) {
+                u32 key = pack_key((const u8*)(entries + i), 4);
+                if (reduced.colorType == PNG_COLOR_TYPE_GRAY) {
+                    samples[i] = (u8)(entries[i].red >> shift);
+                } else {
+                    samples[i] = colors.indices[colors.find(key)];
+                }
+            }
+
+            ArrayAutoPtr<u8> row = new u8[width];
+
+            for (int y = 0; y < height; y++) {
+                const u8* src = pixels + (size_t)y * width;
+                for (int x = 0; x < width; x++) {
+                    row[x] = samples[src[x]];
+                }
+                pack_row(row.get(), width, reduced.bitDepth, reduced.pixels.getBuffer() + (size_t)y * reduced.pitch);
+            }
+
+            return true;
+        }
+
+        int bpp = pfd.bytesPerPixel;
+        ArrayAutoPtr<u8> row = new u8[width * channels];
+
+        for (int y = 0; y < height; y++) {
+            const u8* src = pixels + (size_t)y * width * bpp;
+            u8* dst = row.get();
+
+            switch (reduced.colorType) {
+                case PNG_COLOR_TYPE_GRAY:
+                    for (int x = 0; x < width; x++, src += bpp) {
+                        *dst++ = (u8)(src[0] >> shift);
+                    }
+                    break;
+                case PNG_COLOR_TYPE_GRAY_ALPHA:
+                    for (int x = 0; x < width; x++, src += bpp) {
+                        *dst++ = src[0];
+                        *dst++ = src[3];
+                    }
+                    break;
+                case PNG_COLOR_TYPE_RGB:
+                    for (int x = 0; x < width; x++, src += bpp) {
+                        *dst++ = src[0];
+                        *dst++ = src[1];
+                        *dst++ = src[2];
+                    }
+                    break;
+                case PNG_COLOR_TYPE_PALETTE:
+                {
+                    u32 last_key = pack_key(src, bpp) + 1;
+                    u8 last_index = 0;
+                    for (int x = 0; x < width; x++, src += bpp) {
+                        u32 key = pack_key(src, bpp);
+                        if (key != last_key) {
+                            last_index = colors.indices[colors.find(key)];
+                            last_key = key;
+                        }
+                        *dst++ = last_index;
+                    }
+                    break;
+                }
+            }
+
+            pack_row(row.get(), width * channels, reduced.bitDepth, reduced.pixels.getBuffer() + (size_t)y * reduced.pitch);
+        }
+
+        return true;
+    }
+
+    //--------------------------------------------------------------
+    int ClassifyPixelsScalar(const u8* src, int bpp, int count, int traits)
+    {
+        // RGB pixels are opaque by definition
+        int pending = (bpp == 4 ? traits : traits & ~PixelTraits::Opaque);
+        int failed = 0;
+
+        for (int i = 0; i < count && pending != 0; i++, src += bpp) {
+            if ((pending & PixelTraits::Gray) && (src[0] != src[1] || src[0] != src[2])) {
+                failed |= PixelTraits::Gray;
+            }
+            if ((pending & PixelTraits::Opaque) && src[3] != 255) {
+                failed |= PixelTraits::Opaque;
+            }
+            pending &= ~failed;
+        }
+
+        return traits & ~failed;
+    }
+
+#if defined(AZURA_X86)
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("sse2")
+    int ClassifyPixelsSSE2(const u8* src, int bpp, int count, int traits)
+    {
+        __m128i ones = _mm_set1_epi32(-1);
+        __m128i zero = _mm_setzero_si128();
+
+        if (bpp == 4) {
+            __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+            __m128i low16 = _mm_set1_epi32(0xFFFF);
+
+            while (count >= 4 && traits != 0) {
+                int n = std::min(count, CHUNK_SIZE) & ~3;
+                __m128i all  = ones;
+                __m128i diff = zero;
+
+                for (int i = 0; i < n; i += 4, src += 16) {
+                    __m128i v = _mm_loadu_si128((const __m128i*)src);
+                    all  = _mm_and_si128(all, v);
+                    // red ^ green and green ^ blue in the low 16 bits
+                    diff = _mm_or_si128(diff, _mm_xor_si128(v, _mm_srli_epi32(v, 8)));
+                }
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, alpha), alpha)) != 0xFFFF) {
+                    traits &= ~PixelTraits::Opaque;
+                }
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(diff, low16), zero)) != 0xFFFF) {
+                    traits &= ~PixelTraits::Gray;
+                }
+
+                count -= n;
+            }
+        } else {
+            // five pixels per step, compared with the same bytes shifted
+            // by one and two; the loads reach one pixel beyond the step
+            while (count >= 6 && (traits & PixelTraits::Gray)) {
+                int steps = std::min(count - 1, CHUNK_SIZE) / 5;
+                __m128i equal = ones;
+
+                for (int i = 0; i < steps; i++, src += 15) {
+                    __m128i v  = _mm_loadu_si128((const __m128i*)src);
+                    __m128i v1 = _mm_loadu_si128((const __m128i*)(src + 1));
+                    __m128i v2 = _mm_loadu_si128((const __m128i*)(src + 2));
+                    equal = _mm_and_si128(equal, _mm_and_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)));
+                }
+
+                // only the first byte of each pixel counts
+                if ((_mm_movemask_epi8(equal) & 0x1249) != 0x1249) {
+                    traits &= ~PixelTraits::Gray;
+                }
+
+                count -= steps * 5;
+            }
+        }
+
+        return ClassifyPixelsScalar(src, bpp, count, traits);
+    }
+
+    //--------------------------------------------------------------
+    AZURA_TARGET("avx2")
+    int ClassifyPixelsAVX2(const u8* src, int bpp, int count, int traits)
+    {
+        if (bpp == 4) {
+            __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+            __m256i low16 = _mm256_set1_epi32(0xFFFF);
+            __m256i zero  = _mm256_setzero_si256();
+
+            while (count >= 8 && traits != 0) {
+                int n = std::min(count, CHUNK_SIZE) & ~7;
+                __m256i all  = _mm256_set1_epi32(-1);
+                __m256i diff = zero;
+
+                for (int i = 0; i < n; i += 8, src += 32) {
+                    __m256i v = _mm256_loadu_si256((const __m256i*)src);
+                    all  = _mm256_and_si256(all, v);
+                    diff = _mm256_or_si256(diff, _mm256_xor_si256(v, _mm256_srli_epi32(v, 8)));
+                }
+
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(all, alpha), alpha)) != -1) {
+                    traits &= ~PixelTraits::Opaque;
+                }
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(diff, low16), zero)) != -1) {
+                    traits &= ~PixelTraits::Gray;
+                }
+
+                count -= n;
+            }
+        }
+
+        return ClassifyPixelsSSE2(src, bpp, count, traits);
+    }
+
+#endif
+
+}
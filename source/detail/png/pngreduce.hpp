@@ -0,0 +1,75 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#ifndef AZURA_PNGREDUCE_HPP_INCLUDED
+#define AZURA_PNGREDUCE_HPP_INCLUDED
+
+#include "../../types.hpp"
+#include "../../color.hpp"
+#include "../../Image.hpp"
+#include "../ByteArray.hpp"
+#include "../cpu.hpp"
+
+
+namespace azura {
+
+    struct PixelTraits {
+        enum Enum {
+            Opaque = 1 << 0, /* alpha is 255 everywhere */
+            Gray   = 1 << 1, /* red, green and blue are equal everywhere */
+        };
+    };
+
+    // the smallest lossless PNG representation of an image
+    struct PngReducedImage {
+        int colorType;      /* PNG_COLOR_TYPE_* */
+        int bitDepth;       /* 1, 2, 4 or 8 */
+        int pitch;          /* bytes per row, samples below 8 bits are packed */
+        int bytesPerPixel;  /* filter distance, 1 for packed rows */
+        RGBA palette[256];
+        int paletteSize;    /* entries with an alpha below 255 come first */
+        ByteArray pixels;
+    };
+
+    // looks for a smaller color type or bit depth that holds the image
+    // without loss and converts the image into it; returns false if the
+    // image is best written the way it is; with parallel_readable, only
+    // the 8 bit palette, RGB and RGBA color types that InflateRowsParallel()
+    // decodes are considered
+    bool ReduceColorType(Image* image, bool parallel_readable, PngReducedImage& reduced);
+
+    // returns the traits among the given ones that the count RGB (bpp 3)
+    // or RGBA (bpp 4) pixels at src all share; gives up on the remaining
+    // pixels as soon as none are left
+    int ClassifyPixelsScalar(const u8* src, int bpp, int count, int traits);
+
+#if defined(AZURA_X86)
+    int ClassifyPixelsSSE2(const u8* src, int bpp, int count, int traits);
+    int ClassifyPixelsAVX2(const u8* src, int bpp, int count, int traits);
+#endif
+
+}
+
+
+#endif
@@ -0,0 +1,384 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include <cmath>
+#include <cstring>
+
+#include "quantize.hpp"
+#include "octreequant.hpp"
+#include "mediancut.hpp"
+#include "kmeans.hpp"
+#include "inversecmap.hpp"
+#include "timer.hpp"
+#include "thread.hpp"
+#include "ArrayAutoPtr.hpp"
+
+#define SAMPLE_CHUNK_SIZE 4096
+#define MIN_PART_SIZE     65536 /* pixels, smaller parts aren't worth a thread */
+
+
+namespace azura {
+
+    namespace {
+
+        inline int get_parts_count(int pixels_count)
+        {
+            int parts = pixels_count / MIN_PART_SIZE;
+            int workers = GetWorkerCount();
+
+            if (parts > workers) {
+                parts = workers;
+            }
+
+            return (parts > 1 ? parts : 1);
+        }
+
+        inline int get_part_begin(int count, int parts, int part)
+        {
+            return (int)((i64)count * part / parts);
+        }
+
+        // each part accumulates a band of pixels in its own quantizer
+        class AddPixelsTask : public ParallelTask {
+        public:
+            AddPixelsTask(Quantizer** quantizers, const RGB* pixels, int count, int parts)
+                : _quantizers(quantizers), _pixels(pixels), _count(count), _parts(parts)
+            {
+            }
+
+            void run(int part) {
+                int begin = get_part_begin(_count, _parts, part);
+                int end = get_part_begin(_count, _parts, part + 1);
+                _quantizers[part]->addPixels(_pixels + begin, end - begin);
+            }
+
+        private:
+            Quantizer** _quantizers;
+            const RGB* _pixels;
+            int _count;
+            int _parts;
+        };
+
+        class MapPixelsTask : public ParallelTask {
+        public:
+            MapPixelsTask(Quantizer* quantizer, const RGB* pixels, int count, u8* indices, int parts)
+                : _quantizer(quantizer), _pixels(pixels), _count(count), _indices(indices), _parts(parts)
+            {
+            }
+
+            void run(int part) {
+                int begin = get_part_begin(_count, _parts, part);
+                int end = get_part_begin(_count, _parts, part + 1);
+                _quantizer->mapPixels(_pixels + begin, end - begin, _indices + begin);
+            }
+
+        private:
+            Quantizer* _quantizer;
+            const RGB* _pixels;
+            int _count;
+            u8* _indices;
+            int _parts;
+        };
+
+        class MapToPaletteTask : public ParallelTask {
+        public:
+            MapToPaletteTask(const InverseColormap& colormap, const RGB* pixels, int count, u8* indices, int parts)
+                : _colormap(colormap), _pixels(pixels), _count(count), _indices(indices), _parts(parts)
+            {
+            }
+
+            void run(int part) {
+                int begin = get_part_begin(_count, _parts, part);
+                int end = get_part_begin(_count, _parts, part + 1);
+                _colormap.mapPixels(_pixels + begin, end - begin, _indices + begin);
+            }
+
+        private:
+            const InverseColormap& _colormap;
+            const RGB* _pixels;
+            int _count;
+            u8* _indices;
+            int _parts;
+        };
+
+        // sums up the squared error of each part separately
+        class ErrorTask : public ParallelTask {
+        public:
+            ErrorTask(const RGB* pixels, int count, const u8* indices, const RGB* palette, u64* errors, int parts)
+                : _pixels(pixels), _count(count), _indices(indices), _palette(palette), _errors(errors), _parts(parts)
+            {
+            }
+
+            void run(int part) {
+                int begin = get_part_begin(_count, _parts, part);
+                int end = get_part_begin(_count, _parts, part + 1);
+                u64 error = 0;
+
+                for (int i = begin; i < end; i++) {
+                    const RGB& src = _pixels[i];
+                    const RGB& dst = _palette[_indices[i]];
+
+                    int dr = src.red   - dst.red;
+                    int dg = src.green - dst.green;
+                    int db = src.blue  - dst.blue;
+
+                    error += dr * dr + dg * dg + db * db;
+                }
+
+                _errors[part] = error;
+            }
+
+        private:
+            const RGB* _pixels;
+            int _count;
+            const u8* _indices;
+            const RGB* _palette;
+            u64* _errors;
+            int _parts;
+        };
+
+        // accumulates all pixels, split across threads; the partial results
+        // are exact integer counts and sums, so the merged result doesn't
+        // depend on how the pixels were split
+        void add_pixels(Quantizer* quantizer, const RGB* pixels, int count, const QuantizeOptions& options)
+        {
+            int parts = get_parts_count(count);
+
+            if (parts == 1) {
+                quantizer->addPixels(pixels, count);
+                return;
+            }
+
+            // the quantizers are created and released on this thread, since
+            // reference counting isn't thread safe
+            ArrayAutoPtr<Quantizer::Ptr> partials = new Quantizer::Ptr[parts];
+            ArrayAutoPtr<Quantizer*> quantizers = new Quantizer*[parts];
+
+            quantizers[0] = quantizer;
+            for (int i = 1; i < parts; i++) {
+                partials[i] = CreateQuantizer(options);
+                quantizers[i] = partials[i].get();
+            }
+
+            AddPixelsTask task(quantizers.get(), pixels, count, parts);
+            RunParallel(task, parts);
+
+            for (int i = 1; i < parts; i++) {
+                quantizer->merge(*quantizers[i]);
+            }
+        }
+
+        // collects sampled pixels and passes them on in chunks
+        class SampleBuffer {
+        public:
+            explicit SampleBuffer(Quantizer* quantizer)
+                : _quantizer(quantizer)
+                , _count(0)
+                , _total(0)
+            {
+            }
+
+            void add(const RGB& pixel) {
+                _pixels[_count++] = pixel;
+                if (_count == SAMPLE_CHUNK_SIZE) {
+                    flush();
+                }
+            }
+
+            void flush() {
+                _quantizer->addPixels(_pixels, _count);
+                _total += _count;
+                _count = 0;
+            }
+
+            int getTotal() const {
+                return _total;
+            }
+
+        private:
+            Quantizer* _quantizer;
+            RGB _pixels[SAMPLE_CHUNK_SIZE];
+            int _count;
+            int _total;
+        };
+
+    }
+
+    //--------------------------------------------------------------
+    Quantizer::Ptr CreateQuantizer(const QuantizeOptions& options)
+    {
+        switch (options.method)
+        {
+            case QuantizeMethod::MedianCut:
+                return new MedianCutContext();
+            case QuantizeMethod::Octree:
+                return new OctreeQuantContext();
+            case QuantizeMethod::KMeans:
+                return new KMeansQuantContext(options.iterations);
+            default:
+                return 0;
+        }
+    }
+
+    //--------------------------------------------------------------
+    int AddPixels(Quantizer* quantizer, const RGB* pixels, int width, int height, const QuantizeOptions& options)
+    {
+        int pixels_count = width * height;
+
+        double wanted = pixels_count * options.sampleRate;
+        if (wanted < options.minSamples) {
+            wanted = options.minSamples;
+        }
+
+        if (options.sampling == QuantizeSampling::None || wanted >= pixels_count) {
+            add_pixels(quantizer, pixels, pixels_count, options);
+            return pixels_count;
+        }
+
+        SampleBuffer samples(quantizer);
+        int samples_count = (wanted > 1 ? (int)wanted : 1);
+
+        if (options.sampling == QuantizeSampling::Stride) {
+            // the center pixel of each cell of a square grid; cells that
+            // would be wider or taller than the image are stretched along
+            // the other axis, so narrow images are still sampled
+            double cell_area = (double)pixels_count / samples_count;
+            double step_x = std::sqrt(cell_area);
+            double step_y = step_x;
+
+            if (step_x > width) {
+                step_x = width;
+                step_y = cell_area / step_x;
+            } else if (step_y > height) {
+                step_y = height;
+                step_x = cell_area / step_y;
+            }
+
+            for (double y = step_y / 2; y < height; y += step_y) {
+                const RGB* row = pixels + (int)y * width;
+
+                for (double x = step_x / 2; x < width; x += step_x) {
+                    samples.add(row[(int)x]);
+                }
+            }
+        } else {
+            // the R2 low discrepancy sequence (a generalized golden ratio
+            // sequence) spreads points evenly without forming a grid,
+            // much like blue noise does
+            const double g  = 1.32471795724474602596;
+            const double a1 = 1.0 / g;
+            const double a2 = 1.0 / (g * g);
+
+            double u = 0.5;
+            double v = 0.5;
+
+            for (int i = 0; i < samples_count; i++) {
+                int x = (int)(u * width);
+                int y = (int)(v * height);
+
+                samples.add(pixels[y * width + x]);
+
+                u += a1;
+                v += a2;
+                if (u >= 1.0) { u -= 1.0; }
+                if (v >= 1.0) { v -= 1.0; }
+            }
+        }
+
+        samples.flush();
+        return samples.getTotal();
+    }
+
+    //--------------------------------------------------------------
+    void MapPixels(Quantizer* quantizer, const RGB* pixels, int count, u8* indices)
+    {
+        int parts = get_parts_count(count);
+
+        MapPixelsTask task(quantizer, pixels, count, indices, parts);
+        RunParallel(task, parts);
+    }
+
+    //--------------------------------------------------------------
+    int Quantize(const RGB* src_pixels, int width, int height, u8* dst_pixels, RGB dst_palette[256], const QuantizeOptions& options, QuantizeStats* stats)
+    {
+        Quantizer::Ptr quantizer = CreateQuantizer(options);
+        if (!quantizer) {
+            return 0;
+        }
+
+        int pixels_count = width * height;
+
+        double t0 = GetTimeStamp();
+
+        int samples_count = AddPixels(quantizer.get(), src_pixels, width, height, options);
+        int colors_count = quantizer->buildPalette(dst_palette);
+
+        double t1 = GetTimeStamp();
+
+        MapPixels(quantizer.get(), src_pixels, pixels_count, dst_pixels);
+
+        double t2 = GetTimeStamp();
+
+        if (colors_count < 256) {
+            // unused palette entries stay black
+            std::memset(dst_palette + colors_count, 0, (256 - colors_count) * sizeof(RGB));
+        }
+
+        if (stats) {
+            stats->colorCount = colors_count;
+            stats->sampleCount = samples_count;
+            stats->paletteTime = t1 - t0;
+            stats->mappingTime = t2 - t1;
+
+            int parts = get_parts_count(pixels_count);
+
+            ArrayAutoPtr<u64> errors = new u64[parts];
+            ErrorTask error_task(src_pixels, pixels_count, dst_pixels, dst_palette, errors.get(), parts);
+            RunParallel(error_task, parts);
+
+            u64 error = 0;
+            for (int i = 0; i < parts; i++) {
+                error += errors[i];
+            }
+
+            double mse = (pixels_count > 0 ? (double)error / (3.0 * pixels_count) : 0.0);
+
+            stats->meanSquaredError = mse;
+            stats->psnr = (mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 0.0);
+        }
+
+        return colors_count;
+    }
+
+    //--------------------------------------------------------------
+    void MapToPalette(const RGB* src_pixels, int pixels_count, u8* dst_pixels, const RGB* palette, int palette_size)
+    {
+        InverseColormap colormap(palette, palette_size);
+
+        int parts = get_parts_count(pixels_count);
+
+        MapToPaletteTask task(colormap, src_pixels, pixels_count, dst_pixels, parts);
+        RunParallel(task, parts);
+    }
+
+}
@@ -0,0 +1,81 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_DETAIL_QUANTIZE_HPP_INCLUDED
+#define AZURA_DETAIL_QUANTIZE_HPP_INCLUDED
+
+#include "../RefCounted.hpp"
+#include "../RefPtr.hpp"
+#include "../types.hpp"
+#include "../color.hpp"
+#include "../quantize.hpp"
+
+
+namespace azura {
+
+    // common interface of the quantization algorithms; a quantizer
+    // holds all state of a run and must not be shared between threads,
+    // except for mapping pixels as noted below
+    class Quantizer : public RefCounted {
+    public:
+        typedef RefPtr<Quantizer> Ptr;
+
+        virtual void reset() = 0;
+
+        // accumulates the colors of the given pixels
+        virtual void addPixels(const RGB* pixels, int count) = 0;
+
+        // adds the colors accumulated by another quantizer, which must have
+        // been created with the same options; the result is the same as if
+        // all pixels had been added to this quantizer
+        virtual void merge(const Quantizer& other) = 0;
+
+        // reduces the accumulated colors to at most 256 palette entries
+        // and returns the number of entries written to the palette
+        virtual int buildPalette(RGB palette[256]) = 0;
+
+        // maps pixels to the palette built last; may be called from several
+        // threads at once, the result doesn't depend on the call order
+        virtual void mapPixels(const RGB* pixels, int count, u8* indices) = 0;
+    };
+
+    Quantizer::Ptr CreateQuantizer(const QuantizeOptions& options);
+
+    // feeds the quantizer the pixels of an image selected by the sampling
+    // options and returns their number; the selection only depends on the
+    // image size, so it is the same on every run
+    int AddPixels(Quantizer* quantizer, const RGB* pixels, int width, int height, const QuantizeOptions& options);
+
+    // maps the pixels to the quantizer's palette, split across threads
+    void MapPixels(Quantizer* quantizer, const RGB* pixels, int count, u8* indices);
+
+    // quantizes an image in one go and returns the palette size
+    int Quantize(const RGB* src_pixels, int width, int height, u8* dst_pixels, RGB dst_palette[256], const QuantizeOptions& options, QuantizeStats* stats = 0);
+
+    // maps the pixels onto an arbitrary palette, picking the nearest entry
+    void MapToPalette(const RGB* src_pixels, int pixels_count, u8* dst_pixels, const RGB* palette, int palette_size);
+
+}
+
+
+#endif
@@ -0,0 +1,313 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include "../platform.hpp"
+#include "../types.hpp"
+#include "thread.hpp"
+
+#if defined(AZURA_WINDOWS)
+#    include <windows.h>
+#    include <process.h>
+#else
+#    include <pthread.h>
+#    include <unistd.h>
+#endif
+
+#define MAX_WORKERS 64
+
+
+namespace azura {
+
+    namespace {
+
+        int WorkerCount = 0;
+
+        struct worker_range {
+            ParallelTask* task;
+            int begin;
+            int end;
+        };
+
+        void run_range(const worker_range& range)
+        {
+            for (int part = range.begin; part < range.end; part++) {
+                range.task->run(part);
+            }
+        }
+
+        // the workers started once and kept for all later calls; a call
+        // publishes one range per worker and bumps the generation, each
+        // worker runs the range of its own index and goes back to waiting
+        struct worker_pool {
+            int threads;                       /* started workers, indices 1 to threads */
+            bool busy;                         /* a call is using the workers */
+            u32 generation;                    /* counts the calls */
+            u32 seen[MAX_WORKERS];             /* last generation each worker handled */
+            worker_range ranges[MAX_WORKERS];
+            int rangesCount;
+            int pending;                       /* workers still running their range */
+        };
+
+        worker_pool Pool; /* zero-initialized */
+
+#if defined(AZURA_WINDOWS)
+        SRWLOCK PoolLock = SRWLOCK_INIT;
+        CONDITION_VARIABLE PoolWake = CONDITION_VARIABLE_INIT;
+        CONDITION_VARIABLE PoolDone = CONDITION_VARIABLE_INIT;
+
+        inline void lock_pool()   { AcquireSRWLockExclusive(&PoolLock); }
+        inline void unlock_pool() { ReleaseSRWLockExclusive(&PoolLock); }
+        inline void wait_pool(CONDITION_VARIABLE& cond) { SleepConditionVariableSRW(&cond, &PoolLock, INFINITE, 0); }
+        inline void wake_all(CONDITION_VARIABLE& cond)  { WakeAllConditionVariable(&cond); }
+#else
+        pthread_mutex_t PoolLock = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t PoolWake = PTHREAD_COND_INITIALIZER;
+        pthread_cond_t PoolDone = PTHREAD_COND_INITIALIZER;
+
+        inline void lock_pool()   { pthread_mutex_lock(&PoolLock); }
+        inline void unlock_pool() { pthread_mutex_unlock(&PoolLock); }
+        inline void wait_pool(pthread_cond_t& cond) { pthread_cond_wait(&cond, &PoolLock); }
+        inline void wake_all(pthread_cond_t& cond)  { pthread_cond_broadcast(&cond); }
+#endif
+
+        void pool_worker_loop(int index)
+        {
+            lock_pool();
+
+            for (;;) {
+                while (Pool.seen[index] == Pool.generation) {
+                    wait_pool(PoolWake);
+                }
+
+                Pool.seen[index] = Pool.generation;
+
+                if (index < Pool.rangesCount) {
+                    worker_range range = Pool.ranges[index];
+
+                    unlock_pool();
+                    run_range(range);
+                    lock_pool();
+
+                    if (--Pool.pending == 0) {
+                        wake_all(PoolDone);
+                    }
+                }
+            }
+        }
+
+#if defined(AZURA_WINDOWS)
+        unsigned __stdcall worker_main(void* arg)
+        {
+            run_range(*(worker_range*)arg);
+            return 0;
+        }
+
+        unsigned __stdcall pool_worker_main(void* arg)
+        {
+            pool_worker_loop((int)(INT_PTR)arg);
+            return 0;
+        }
+
+        bool start_pool_worker(int index)
+        {
+            HANDLE thread = (HANDLE)_beginthreadex(0, 0, pool_worker_main, (void*)(INT_PTR)index, 0, 0);
+            if (!thread) {
+                return false;
+            }
+            CloseHandle(thread);
+            return true;
+        }
+#else
+        void* worker_main(void* arg)
+        {
+            run_range(*(worker_range*)arg);
+            return 0;
+        }
+
+        void* pool_worker_main(void* arg)
+        {
+            pool_worker_loop((int)(intptr_t)arg);
+            return 0;
+        }
+
+        bool start_pool_worker(int index)
+        {
+            pthread_t thread;
+            if (pthread_create(&thread, 0, pool_worker_main, (void*)(intptr_t)index) != 0) {
+                return false;
+            }
+            pthread_detach(thread);
+            return true;
+        }
+#endif
+
+        int get_processor_count()
+        {
+#if defined(AZURA_WINDOWS)
+            SYSTEM_INFO si;
+            GetSystemInfo(&si);
+            int n = (int)si.dwNumberOfProcessors;
+#else
+            int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+            return (n > 0 ? n : 1);
+        }
+
+        void split_parts(ParallelTask& task, int parts, worker_range* ranges, int workers)
+        {
+            for (int i = 0; i < workers; i++) {
+                ranges[i].task  = &task;
+                ranges[i].begin = (int)((i64)parts * i / workers);
+                ranges[i].end   = (int)((i64)parts * (i + 1) / workers);
+            }
+        }
+
+        // runs the ranges on threads started for this call only, which
+        // is what nested and concurrent calls do while the pool is busy
+        void run_on_new_threads(worker_range* ranges, int workers)
+        {
+            // start the other workers, falling back to running
+            // a range on the calling thread if that fails
+#if defined(AZURA_WINDOWS)
+            HANDLE threads[MAX_WORKERS];
+
+            for (int i = 1; i < workers; i++) {
+                threads[i] = (HANDLE)_beginthreadex(0, 0, worker_main, &ranges[i], 0, 0);
+                if (!threads[i]) {
+                    run_range(ranges[i]);
+                }
+            }
+
+            run_range(ranges[0]);
+
+            for (int i = 1; i < workers; i++) {
+                if (threads[i]) {
+                    WaitForSingleObject(threads[i], INFINITE);
+                    CloseHandle(threads[i]);
+                }
+            }
+#else
+            pthread_t threads[MAX_WORKERS];
+            bool started[MAX_WORKERS];
+
+            for (int i = 1; i < workers; i++) {
+                started[i] = (pthread_create(&threads[i], 0, worker_main, &ranges[i]) == 0);
+                if (!started[i]) {
+                    run_range(ranges[i]);
+                }
+            }
+
+            run_range(ranges[0]);
+
+            for (int i = 1; i < workers; i++) {
+                if (started[i]) {
+                    pthread_join(threads[i], 0);
+                }
+            }
+#endif
+        }
+
+    }
+
+    //--------------------------------------------------------------
+    void SetWorkerCount(int count)
+    {
+        WorkerCount = (count > 0 ? count : 0);
+    }
+
+    //--------------------------------------------------------------
+    int GetWorkerCount()
+    {
+        int n = (WorkerCount > 0 ? WorkerCount : get_processor_count());
+        return (n < MAX_WORKERS ? n : MAX_WORKERS);
+    }
+
+    //--------------------------------------------------------------
+    void RunParallel(ParallelTask& task, int parts)
+    {
+        int workers = GetWorkerCount();
+        if (workers > parts) {
+            workers = parts;
+        }
+
+        if (workers <= 1) {
+            for (int part = 0; part < parts; part++) {
+                task.run(part);
+            }
+            return;
+        }
+
+        lock_pool();
+
+        if (Pool.busy) {
+            // called from a running part or from another thread
+            unlock_pool();
+
+            worker_range ranges[MAX_WORKERS];
+            split_parts(task, parts, ranges, workers);
+            run_on_new_threads(ranges, workers);
+            return;
+        }
+
+        Pool.busy = true;
+
+        // start the missing workers; if that fails, the parts are
+        // split among the ones there are
+        while (Pool.threads < workers - 1) {
+            int index = Pool.threads + 1;
+            Pool.seen[index] = Pool.generation;
+
+            if (!start_pool_worker(index)) {
+                break;
+            }
+
+            Pool.threads = index;
+        }
+
+        if (workers > Pool.threads + 1) {
+            workers = Pool.threads + 1;
+        }
+
+        split_parts(task, parts, Pool.ranges, workers);
+        Pool.rangesCount = workers;
+        Pool.pending = workers - 1;
+        Pool.generation++;
+
+        wake_all(PoolWake);
+
+        // the calling thread takes the first range
+        worker_range first = Pool.ranges[0];
+
+        unlock_pool();
+        run_range(first);
+        lock_pool();
+
+        while (Pool.pending > 0) {
+            wait_pool(PoolDone);
+        }
+
+        Pool.busy = false;
+        unlock_pool();
+    }
+
+}
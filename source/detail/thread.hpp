@@ -0,0 +1,58 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_THREAD_HPP_INCLUDED
+#define AZURA_THREAD_HPP_INCLUDED
+
+
+namespace azura {
+
+    // work split into independent parts that may run concurrently;
+    // implementations must not touch reference counts from run(),
+    // as those aren't thread safe
+    class ParallelTask {
+    public:
+        virtual ~ParallelTask() { }
+
+        virtual void run(int part) = 0;
+    };
+
+    // sets the number of threads parallel work is spread across,
+    // 0 selects one thread per processor
+    void SetWorkerCount(int count);
+
+    // returns the effective number of threads, at least 1
+    int GetWorkerCount();
+
+    // runs all parts of the task and returns when they are done; the
+    // parts are statically distributed over up to GetWorkerCount()
+    // threads, with the calling thread taking the first share; the other
+    // threads are started on first use and kept, only calls made while
+    // they are busy (from a running part or another thread) start
+    // threads of their own
+    void RunParallel(ParallelTask& task, int parts);
+
+}
+
+
+#endif
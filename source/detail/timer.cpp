@@ -0,0 +1,55 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#include "../platform.hpp"
+#include "timer.hpp"
+
+#if defined(AZURA_WINDOWS)
+#    include <windows.h>
+#else
+#    include <sys/time.h>
+#endif
+
+
+namespace azura {
+
+    //--------------------------------------------------------------
+    double GetTimeStamp()
+    {
+#if defined(AZURA_WINDOWS)
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER counter;
+
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&counter);
+
+        return counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+        timeval tv;
+        gettimeofday(&tv, 0);
+
+        return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+    }
+
+}
@@ -0,0 +1,145 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_OPTIONS_HPP_INCLUDED
+#define AZURA_OPTIONS_HPP_INCLUDED
+
+
+namespace azura {
+
+    struct BmpCompression {
+        enum Enum {
+            None = 0,
+            RLE8 = 1, // palettized images only, others are written uncompressed
+            Count,
+        };
+    };
+
+    struct BmpWriteOptions {
+        BmpCompression::Enum compression;
+
+        BmpWriteOptions()
+            : compression(BmpCompression::None)
+        {
+        }
+    };
+
+    // row filters, the values match libpng's PNG_FILTER_* flags
+    struct PngFilters {
+        enum Enum {
+            Auto    = 0x00, /* libpng's choice: none for palettized images, all for others */
+            None    = 0x08,
+            Sub     = 0x10,
+            Up      = 0x20,
+            Average = 0x40,
+            Paeth   = 0x80,
+            All     = 0xF8,
+        };
+    };
+
+    // the values match zlib's Z_* strategies
+    struct PngStrategy {
+        enum Enum {
+            Auto        = -1, /* libpng's choice: filtered for filtered rows, default otherwise */
+            Default     = 0,
+            Filtered    = 1,
+            HuffmanOnly = 2,
+            RLE         = 3,
+            Fixed       = 4,
+            Count,
+        };
+    };
+
+    struct PngEncoder {
+        enum Enum {
+            Standard = 0, /* libpng, on the calling thread */
+            Parallel = 1, /* bands of rows deflated on all worker threads */
+            Indexed  = 2, /* like parallel, with independent bands that azura reads back in parallel as well */
+            Fast     = 3, /* fixed filter and a run-only deflate, ignores the zlib settings and filters */
+            Count,
+        };
+    };
+
+    struct PngPreset {
+        enum Enum {
+            Fastest  = 0, /* quick previews, larger files */
+            Balanced = 1, /* libpng's defaults */
+            Smallest = 2, /* maximum compression */
+            Count,
+        };
+    };
+
+    struct PngWriteOptions {
+        int compressionLevel;     /* zlib level, 0 to 9 */
+        int memLevel;             /* zlib memory level, 1 to 9 */
+        int windowBits;           /* zlib window size, 8 to 15 */
+        PngStrategy::Enum strategy;
+        int filters;              /* PngFilters flags combined */
+        PngEncoder::Enum encoder;
+        bool reduceColorType;     /* write gray, RGB or a palette instead if that holds the image without loss */
+
+        PngWriteOptions(PngPreset::Enum preset = PngPreset::Balanced)
+            : compressionLevel(6)
+            , memLevel(8)
+            , windowBits(15)
+            , strategy(PngStrategy::Auto)
+            , filters(PngFilters::Auto)
+            , encoder(PngEncoder::Standard)
+            , reduceColorType(false)
+        {
+            if (preset == PngPreset::Fastest) {
+                compressionLevel = 1;
+                strategy = PngStrategy::RLE;
+            } else if (preset == PngPreset::Smallest) {
+                compressionLevel = 9;
+                memLevel = 9;
+            }
+        }
+    };
+
+    struct PngReadOptions {
+        bool verifyChecksums;     /* false skips the chunk CRCs and the zlib Adler-32, for trusted input only */
+
+        PngReadOptions()
+            : verifyChecksums(true)
+        {
+        }
+    };
+
+    // per format settings for ReadImage, formats without
+    // settings of their own ignore them
+    struct ReadOptions {
+        PngReadOptions png;
+    };
+
+    // per format settings for WriteImage, formats without
+    // settings of their own ignore them
+    struct WriteOptions {
+        BmpWriteOptions bmp;
+        PngWriteOptions png;
+    };
+
+}
+
+
+#endif
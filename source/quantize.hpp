@@ -0,0 +1,110 @@
+/*
+    The MIT License (MIT)
+
+    Copyright (c) 2013-2014 Anatoli Steinmark
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+#ifndef AZURA_QUANTIZE_HPP_INCLUDED
+#define AZURA_QUANTIZE_HPP_INCLUDED
+
+#include "RefCounted.hpp"
+#include "RefPtr.hpp"
+#include "Image.hpp"
+
+
+namespace azura {
+
+    struct QuantizeMethod {
+        enum Enum {
+            MedianCut = 0, /* fastest, fixed 15 bit color buckets */
+            Octree    = 1, /* balanced */
+            KMeans    = 2, /* octree palette refined by k-means, best quality */
+            Count,
+            Default   = Octree,
+        };
+    };
+
+    // selects the pixels the palette is built from; the final
+    // mapping always covers every pixel of the image
+    struct QuantizeSampling {
+        enum Enum {
+            None      = 0, /* build the palette from all pixels */
+            Stride    = 1, /* one pixel per cell of a regular grid */
+            BlueNoise = 2, /* evenly spread, irregular sample positions */
+            Count,
+        };
+    };
+
+    struct QuantizeOptions {
+        QuantizeMethod::Enum method;
+        int iterations; /* maximum number of k-means iterations */
+
+        QuantizeSampling::Enum sampling;
+        double sampleRate; /* fraction of the pixels to sample */
+        int minSamples;    /* lower bound for the number of samples */
+
+        QuantizeOptions(QuantizeMethod::Enum m = QuantizeMethod::Default)
+            : method(m)
+            , iterations(8)
+            , sampling(QuantizeSampling::None)
+            , sampleRate(0.01)
+            , minSamples(65536)
+        {
+        }
+    };
+
+    struct QuantizeStats {
+        int colorCount;          /* number of palette entries in use */
+        int sampleCount;         /* number of pixels the palette was built from */
+        double paletteTime;      /* milliseconds spent building the palette */
+        double mappingTime;      /* milliseconds spent mapping the pixels */
+        double meanSquaredError; /* per channel, over all pixels */
+        double psnr;             /* peak signal to noise ratio in dB, 0 if lossless */
+    };
+
+    // builds one palette for many images, e.g. the frames of an animation;
+    // the colors of all images are accumulated incrementally, so they never
+    // need to be in memory at the same time
+    class PaletteBuilder : public RefCounted {
+    public:
+        typedef RefPtr<PaletteBuilder> Ptr;
+
+        // accumulates the colors of the image
+        virtual bool addImage(Image* image) = 0;
+
+        // builds the palette from all images added so far and returns
+        // the number of palette entries in use
+        virtual int buildPalette() = 0;
+
+        virtual const RGB* getPalette() const = 0;
+        virtual int getColorCount() const = 0;
+
+        // maps an image to the palette built last
+        virtual Image::Ptr mapImage(Image* image, PixelFormat::Enum pf = PixelFormat::RGB_P8) = 0;
+
+        // maps several images at once, spreading them across threads; the
+        // results are stored in the given array, failed ones are null
+        virtual bool mapImages(Image** images, int count, Image::Ptr* results, PixelFormat::Enum pf = PixelFormat::RGB_P8) = 0;
+    };
+
+}
+
+
+#endif
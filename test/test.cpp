@@ -1,10 +1,118 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
 #include <azura.hpp>
 
 using namespace std;
 using namespace azura;
 
 
+void PutBmpValue(vector<u8>& bmp, u32 value, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        bmp.push_back((u8)(value >> (i * 8)));
+    }
+}
+
+// builds a BMP file with an info header of header_size bytes, which
+// carries the four masks if it is a newer one, and reads it back
+Image::Ptr ReadBmpFromMemory(int header_size, int width, int height, int bpp, u32 compression, const u32 masks[4], const u8* table, int table_size, const u8* rows, int rows_size)
+{
+    int masks_size = (header_size == 40 && compression == 3 /* BI_BITFIELDS */ ? 12 : 0);
+    int offset = 14 + header_size + masks_size + table_size * 4;
+
+    vector<u8> bmp;
+    bmp.push_back('B');
+    bmp.push_back('M');
+    PutBmpValue(bmp, offset + rows_size, 4); // bfSize
+    PutBmpValue(bmp, 0, 4);                  // bfReserved1, bfReserved2
+    PutBmpValue(bmp, offset, 4);             // bfOffBits
+    PutBmpValue(bmp, header_size, 4);        // biSize
+    PutBmpValue(bmp, width, 4);              // biWidth
+    PutBmpValue(bmp, height, 4);             // biHeight, negative for top-down
+    PutBmpValue(bmp, 1, 2);                  // biPlanes
+    PutBmpValue(bmp, bpp, 2);                // biBitCount
+    PutBmpValue(bmp, compression, 4);        // biCompression
+    PutBmpValue(bmp, rows_size, 4);          // biSizeImage
+    PutBmpValue(bmp, 0, 16);                 // biXPelsPerMeter .. biClrImportant
+    if (header_size > 40 || masks_size > 0) {
+        for (int i = 0; i < (masks_size > 0 ? 3 : 4); i++) {
+            PutBmpValue(bmp, masks[i], 4);
+        }
+    }
+    bmp.resize(14 + header_size + masks_size, 0); // color space information
+    bmp.insert(bmp.end(), table, table + table_size * 4);
+    bmp.insert(bmp.end(), rows, rows + rows_size);
+
+    return ReadImage(CreateMemoryFile(&bmp[0], (int)bmp.size()), FileFormat::BMP);
+}
+
+// scales a field of up to 8 bits to 8 bits by repeating its bits
+u8 ExpandBmpField(u32 value, int bits)
+{
+    u32 expanded = value << (8 - bits);
+    for (int k = bits; k < 8; k *= 2) {
+        expanded |= expanded >> k;
+    }
+    return (u8)expanded;
+}
+
+// reads a 37 pixel wide bitfields BMP of noise and checks every pixel
+// against the masks
+bool CheckBitfieldsBmp(int header_size, int height, int bpp, const u32 masks[4])
+{
+    // odd width and a few rows, so both the vector loops and their
+    // tails see pixels and the rows need padding
+    const int width = 37;
+    int row_size = (width * bpp / 8 + 3) & ~3;
+
+    vector<u8> rows(row_size * abs(height), 0);
+    u32 seed = 7;
+    for (int y = 0; y < abs(height); y++) {
+        for (int x = 0; x < width * bpp / 8; x++) {
+            seed = seed * 1103515245 + 12345;
+            rows[y * row_size + x] = (u8)(seed >> 16);
+        }
+    }
+
+    Image::Ptr image = ReadBmpFromMemory(header_size, width, height, bpp, 3 /* BI_BITFIELDS */, masks, 0, 0, &rows[0], (int)rows.size());
+    PixelFormat::Enum pf = (masks[3] != 0 ? PixelFormat::BGRA : PixelFormat::BGR);
+    if (!image || image->getPixelFormat() != pf) {
+        return false;
+    }
+
+    int bytes_per_pixel = (pf == PixelFormat::BGRA ? 4 : 3);
+
+    for (int y = 0; y < abs(height); y++) {
+        // positive heights store the bottom row first
+        int iy = (height > 0 ? abs(height) - 1 - y : y);
+        const u8* row = &rows[y * row_size];
+
+        for (int x = 0; x < width; x++) {
+            const u8* p = row + x * bpp / 8;
+            u32 pixel = (bpp == 16 ? p[0] | (p[1] << 8) : p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24));
+            const u8* actual = image->getPixels() + (iy * width + x) * bytes_per_pixel;
+
+            for (int c = 0; c < bytes_per_pixel; c++) {
+                // masks are red, green, blue, alpha; BGR(A) pixels are
+                // blue, green, red, alpha
+                u32 mask = masks[c == 3 ? 3 : 2 - c];
+                int shift = 0;
+                int bits = 0;
+                while (((mask >> shift) & 1) == 0) { shift++; }
+                while (shift + bits < 32 && ((mask >> (shift + bits)) & 1) != 0) { bits++; }
+
+                if (actual[c] != ExpandBmpField((pixel & mask) >> shift, bits)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
 void RunBmpTests()
 {
     /* Test read */
@@ -26,6 +134,79 @@ void RunBmpTests()
         return;
     }
     cout << "done" << endl;
+
+    /* Test RLE8 write and read */
+
+    cout << "Writing and reading 'out_rle8.bmp'...";
+    Image::Ptr indexed_image = image->convert(PixelFormat::RGB_P8);
+    WriteOptions options;
+    options.bmp.compression = BmpCompression::RLE8;
+    Image::Ptr rle_image;
+    if (indexed_image && WriteImage(indexed_image, "out_rle8.bmp", FileFormat::BMP, options)) {
+        rle_image = ReadImage("out_rle8.bmp");
+    }
+    if (!rle_image || rle_image->getPixelFormat() != PixelFormat::RGB_P8 ||
+        memcmp(rle_image->getPixels(), indexed_image->getPixels(), image->getWidth() * image->getHeight()) != 0 ||
+        memcmp(rle_image->getPalette(), indexed_image->getPalette(), 256 * sizeof(RGB)) != 0)
+    {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    /* Test bitfields */
+
+    cout << "Reading 16-bit 5-6-5 bitfields...";
+    const u32 masks_565[4] = { 0xF800, 0x07E0, 0x001F, 0 };
+    if (!CheckBitfieldsBmp(40, 5, 16, masks_565)) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    cout << "Reading 32-bit ARGB and RGBA with a V5 header...";
+    const u32 masks_argb[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 };
+    const u32 masks_rgba[4] = { 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF };
+    if (!CheckBitfieldsBmp(124, -5, 32, masks_argb) || !CheckBitfieldsBmp(124, 5, 32, masks_rgba)) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    /* Test color tables */
+
+    cout << "Reading 1-bit, 4-bit and RLE4 bitmaps...";
+    u8 table[16 * 4];
+    for (int i = 0; i < 16 * 4; i++) {
+        table[i] = (u8)(i * 4);
+    }
+    const u32 no_masks[4] = { 0, 0, 0, 0 };
+    // one row each, padded to 4 bytes
+    const u8 rows_1[]    = { 0xA5, 0xC0, 0, 0 };
+    const u8 rows_4[]    = { 0x12, 0x34, 0x50, 0 };
+    // bottom row: a run of five alternating 1 and 2; top row: three
+    // absolute pixels, then a run of two 6
+    const u8 rows_rle4[] = { 5, 0x12, 0, 0,  0, 3, 0x34, 0x50, 2, 0x66, 0, 0,  0, 1 };
+    const u8 expected_1[]    = { 1, 0, 1, 0, 0, 1, 0, 1, 1, 1 };
+    const u8 expected_4[]    = { 1, 2, 3, 4, 5 };
+    const u8 expected_rle4[] = { 3, 4, 5, 6, 6,  1, 2, 1, 2, 1 };
+    Image::Ptr image_1    = ReadBmpFromMemory(40, 10, 1, 1, 0 /* BI_RGB */, no_masks, table, 2, rows_1, sizeof(rows_1));
+    Image::Ptr image_4    = ReadBmpFromMemory(40, 5, 1, 4, 0 /* BI_RGB */, no_masks, table, 16, rows_4, sizeof(rows_4));
+    Image::Ptr image_rle4 = ReadBmpFromMemory(40, 5, 2, 4, 2 /* BI_RLE4 */, no_masks, table, 16, rows_rle4, sizeof(rows_rle4));
+    if (!image_1 || memcmp(image_1->getPixels(), expected_1, sizeof(expected_1)) != 0 ||
+        !image_4 || memcmp(image_4->getPixels(), expected_4, sizeof(expected_4)) != 0 ||
+        !image_rle4 || memcmp(image_rle4->getPixels(), expected_rle4, sizeof(expected_rle4)) != 0)
+    {
+        cout << "failed" << endl;
+        return;
+    }
+    // color table entries are stored blue, green, red, reserved
+    const RGB& entry = image_4->getPalette()[5];
+    if (entry.red != 5 * 16 + 8 || entry.green != 5 * 16 + 4 || entry.blue != 5 * 16) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
 }
 
 void RunPngTests()
@@ -40,6 +221,15 @@ void RunPngTests()
     }
     cout << "done" << endl;
 
+    cout << "Reading 'test.png' without verifying checksums...";
+    ReadOptions read_options;
+    read_options.png.verifyChecksums = false;
+    if (!ReadImage("../resources/test.png", FileFormat::AutoDetect, PixelFormat::DontCare, read_options)) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
     /* Test write */
 
     cout << "Writing 'out.png'...";
@@ -49,6 +239,119 @@ void RunPngTests()
         return;
     }
     cout << "done" << endl;
+
+    /* Test RGBA palette write and read */
+
+    cout << "Writing and reading 'out_alpha_palette.png'...";
+    // translucent entries first, so the tRNS chunk can be trimmed
+    RGBA alpha_palette[256];
+    for (int i = 0; i < 256; i++) {
+        alpha_palette[i].red   = (u8)i;
+        alpha_palette[i].green = (u8)(255 - i);
+        alpha_palette[i].blue  = (u8)(i * 3);
+        alpha_palette[i].alpha = (u8)(i < 16 ? i * 16 : 255);
+    }
+    u8 alpha_indices[32 * 8];
+    for (int i = 0; i < 32 * 8; i++) {
+        alpha_indices[i] = (u8)(i * 7);
+    }
+    Image::Ptr alpha_image = CreateAlphaPaletteImage(32, 8, PixelFormat::RGBA_P8, alpha_indices, alpha_palette);
+    Image::Ptr alpha_read;
+    if (alpha_image && WriteImage(alpha_image, "out_alpha_palette.png")) {
+        alpha_read = ReadImage("out_alpha_palette.png");
+    }
+    if (!alpha_read || alpha_read->getPixelFormat() != PixelFormat::RGBA_P8 ||
+        memcmp(alpha_read->getPixels(), alpha_indices, sizeof(alpha_indices)) != 0 ||
+        memcmp(alpha_read->getAlphaPalette(), alpha_palette, sizeof(alpha_palette)) != 0)
+    {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    /* Test parallel write */
+
+    cout << "Writing 'out_parallel.png' on worker threads...";
+    WriteOptions options;
+    options.png.encoder = PngEncoder::Parallel;
+    succeeded = WriteImage(image, "out_parallel.png", FileFormat::PNG, options);
+    if (!succeeded || !ReadImage("out_parallel.png")) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    cout << "Writing and reading 'out_indexed.png' with a strip index...";
+    options.png.encoder = PngEncoder::Indexed;
+    succeeded = WriteImage(image, "out_indexed.png", FileFormat::PNG, options);
+    if (!succeeded || !ReadImage("out_indexed.png")) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    cout << "Writing and reading 'out_fast.png' with the fast encoder...";
+    // noise doesn't compress, so the encoder falls back to stored blocks
+    Image::Ptr noise = CreateImage(150, 5000, PixelFormat::RGB);
+    u32 seed = 1;
+    for (int i = 0; i < 150 * 5000 * 3; i++) {
+        seed = seed * 1103515245 + 12345;
+        noise->getPixels()[i] = (u8)(seed >> 16);
+    }
+    options.png.encoder = PngEncoder::Fast;
+    Image::Ptr fast_image;
+    if (WriteImage(noise, "out_fast.png", FileFormat::PNG, options)) {
+        fast_image = ReadImage("out_fast.png", FileFormat::AutoDetect, PixelFormat::RGB);
+    }
+    if (!fast_image || memcmp(fast_image->getPixels(), noise->getPixels(), 150 * 5000 * 3) != 0) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    cout << "Writing 'out_reduced.png' with color type reduction...";
+    // an opaque RGBA image with 12 colors fits into a palette
+    Image::Ptr few_colors = CreateImage(64, 64, PixelFormat::RGBA);
+    for (int i = 0; i < 64 * 64; i++) {
+        u8* p = few_colors->getPixels() + i * 4;
+        int color = (i / 7) % 12;
+        p[0] = (u8)(color * 20);
+        p[1] = (u8)(255 - color * 20);
+        p[2] = (u8)(color * 7);
+        p[3] = 255;
+    }
+    options.png.encoder = PngEncoder::Standard;
+    options.png.reduceColorType = true;
+    Image::Ptr reduced_image;
+    if (WriteImage(few_colors, "out_reduced.png", FileFormat::PNG, options)) {
+        reduced_image = ReadImage("out_reduced.png");
+    }
+    if (!reduced_image || reduced_image->getPixelFormat() != PixelFormat::RGB_P8) {
+        cout << "failed" << endl;
+        return;
+    }
+    reduced_image = reduced_image->convert(PixelFormat::RGBA);
+    if (!reduced_image || memcmp(reduced_image->getPixels(), few_colors->getPixels(), 64 * 64 * 4) != 0) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    /* Test push decoding */
+
+    cout << "Pushing 'test.png' in small chunks...";
+    File::Ptr file = OpenFile("../resources/test.png");
+    PushDecoder::Ptr decoder = CreatePushDecoder(FileFormat::PNG);
+    u8 chunk[1000];
+    int size = 0;
+    while (file && decoder && (size = file->read(chunk, sizeof(chunk))) > 0) {
+        decoder->push(chunk, size);
+    }
+    if (!decoder || !decoder->isComplete() || !decoder->getImage()) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
 }
 
 void RunJpegTests()
@@ -72,6 +375,152 @@ void RunJpegTests()
         return;
     }
     cout << "done" << endl;
+
+    /* Test planar read */
+
+    cout << "Reading 'test.jpg' as planar image...";
+    PlanarImage::Ptr planar_image = ReadPlanarImage("../resources/test.jpg");
+    if (!planar_image || !planar_image->convert(PixelFormat::RGB)) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+}
+
+void RunQuantizeTests()
+{
+    Image::Ptr image = ReadImage("../resources/test.jpg");
+    if (!image) {
+        return;
+    }
+
+    const char* names[] = { "median cut", "octree", "k-means" };
+
+    for (int i = 0; i < QuantizeMethod::Count; i++) {
+        cout << "Quantizing 'test.jpg' using " << names[i] << "...";
+        QuantizeStats stats;
+        Image::Ptr result = QuantizeImage(image, PixelFormat::RGB_P8, QuantizeOptions((QuantizeMethod::Enum)i), &stats);
+        if (!result || stats.colorCount == 0) {
+            cout << "failed" << endl;
+            return;
+        }
+        cout << "done (" << stats.paletteTime + stats.mappingTime << " ms, PSNR " << stats.psnr << " dB)" << endl;
+
+        cout << "Mapping 'test.jpg' onto the " << names[i] << " palette...";
+        Image::Ptr mapped = MapImageToPalette(image, result->getPalette(), stats.colorCount);
+        if (!mapped) {
+            cout << "failed" << endl;
+            return;
+        }
+        cout << "done" << endl;
+    }
+
+    cout << "Mapping a color the sampling skipped...";
+    // bands of red, green and blue with a small dark green patch in a
+    // corner, which falls between the sampled pixels of the grid
+    Image::Ptr bands = CreateImage(2048, 2048, PixelFormat::RGB);
+    u8* band_pixels = bands->getPixels();
+    for (int y = 0; y < 2048; y++) {
+        for (int x = 0; x < 2048; x++) {
+            u8* p = band_pixels + (y * 2048 + x) * 3;
+            p[0] = (y < 683 ? 255 : 0);
+            p[1] = (y >= 683 && y < 1366 ? 128 : 0);
+            p[2] = (y >= 1366 ? 255 : 0);
+            if (x < 4 && y < 4) {
+                p[0] = 0;
+                p[1] = 127;
+            }
+        }
+    }
+    QuantizeOptions sampled(QuantizeMethod::Octree);
+    sampled.sampling = QuantizeSampling::Stride;
+    Image::Ptr sampled_result = QuantizeImage(bands, PixelFormat::RGB_P8, sampled);
+    if (!sampled_result) {
+        cout << "failed" << endl;
+        return;
+    }
+    const RGB& patch = sampled_result->getPalette()[sampled_result->getPixels()[0]];
+    if (patch.red != 0 || patch.green != 128 || patch.blue != 0) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    cout << "Sampling an image narrower than the sampling grid...";
+    // the grid cells are wider than the image, so a square grid
+    // would start past its right edge
+    Image::Ptr narrow = CreateImage(2, 2000000, PixelFormat::RGB);
+    u8* narrow_pixels = narrow->getPixels();
+    for (int i = 0; i < 2 * 2000000; i++) {
+        narrow_pixels[i * 3 + 0] = (u8)(i >> 13);
+        narrow_pixels[i * 3 + 1] = (u8)(i >> 5);
+        narrow_pixels[i * 3 + 2] = (u8)i;
+    }
+    QuantizeMethod::Enum narrow_methods[] = { QuantizeMethod::Octree, QuantizeMethod::MedianCut, QuantizeMethod::KMeans };
+    for (int i = 0; i < 3; i++) {
+        QuantizeOptions narrow_options(narrow_methods[i]);
+        narrow_options.sampling = QuantizeSampling::Stride;
+        QuantizeStats narrow_stats;
+        if (!QuantizeImage(narrow, PixelFormat::RGB_P8, narrow_options, &narrow_stats) || narrow_stats.sampleCount == 0) {
+            cout << "failed" << endl;
+            return;
+        }
+    }
+    cout << "done" << endl;
+
+    cout << "Building a shared palette for 'test.jpg' and 'test.png'...";
+    Image::Ptr images[2] = { image, ReadImage("../resources/test.png") };
+    PaletteBuilder::Ptr builder = CreatePaletteBuilder();
+    if (!images[1] || !builder->addImage(images[0]) || !builder->addImage(images[1]) || builder->buildPalette() == 0) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done (" << builder->getColorCount() << " colors)" << endl;
+
+    cout << "Mapping both images onto the shared palette...";
+    Image::Ptr mapped[2];
+    Image* sources[2] = { images[0].get(), images[1].get() };
+    if (!builder->mapImages(sources, 2, mapped)) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    cout << "Mapping an image that wasn't added to the palette...";
+    // the builder only sees red, green and blue; the dark green
+    // pixel must still end up on the green entry
+    Image::Ptr primaries = CreateImage(3, 1, PixelFormat::RGB);
+    const u8 primary_pixels[] = { 255, 0, 0,  0, 128, 0,  0, 0, 255 };
+    primaries->setPixels(primary_pixels);
+    Image::Ptr dark_green = CreateImage(1, 1, PixelFormat::RGB);
+    const u8 dark_green_pixel[] = { 0, 127, 0 };
+    dark_green->setPixels(dark_green_pixel);
+    PaletteBuilder::Ptr primaries_builder = CreatePaletteBuilder();
+    Image::Ptr dark_green_mapped;
+    if (primaries_builder->addImage(primaries) && primaries_builder->buildPalette() == 3) {
+        dark_green_mapped = primaries_builder->mapImage(dark_green);
+    }
+    if (!dark_green_mapped) {
+        cout << "failed" << endl;
+        return;
+    }
+    const RGB& entry = dark_green_mapped->getPalette()[dark_green_mapped->getPixels()[0]];
+    if (entry.red != 0 || entry.green != 128 || entry.blue != 0) {
+        cout << "failed" << endl;
+        return;
+    }
+    cout << "done" << endl;
+
+    cout << "Building a palette without any images...";
+    QuantizeMethod::Enum empty_methods[] = { QuantizeMethod::Octree, QuantizeMethod::MedianCut, QuantizeMethod::KMeans };
+    for (int i = 0; i < 3; i++) {
+        PaletteBuilder::Ptr empty_builder = CreatePaletteBuilder(QuantizeOptions(empty_methods[i]));
+        if (empty_builder->buildPalette() != 0 || empty_builder->mapImage(dark_green)) {
+            cout << "failed" << endl;
+            return;
+        }
+    }
+    cout << "done" << endl;
 }
 
 int main(int argc, char** argv)
@@ -79,6 +528,7 @@ int main(int argc, char** argv)
     RunBmpTests();
     RunJpegTests();
     RunPngTests();
+    RunQuantizeTests();
 
     return 0;
 }
@@ -0,0 +1,590 @@
+
+/* filter_sse2_intrinsics.c - SSE2 optimized filter functions
+ *
+ * Copyright (c) 2016 Google, Inc.
+ * Written by Mike Klein and Matt Sarett
+ * Derived from arm/filter_neon_intrinsics.c, which was
+ * Copyright (c) 2014 Glenn Randers-Pehrson
+ * Backported to libpng 1.6.10, with run time CPU detection
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#if PNG_INTEL_SSE_OPT > 0
+
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+/* Every function is compiled for the instruction set it needs, whatever the
+ * compiler settings for the rest of libpng are; intel_init.c makes sure that
+ * only the ones the CPU supports get called.  MSVC accepts any intrinsic
+ * without special flags.
+ */
+#if defined(__GNUC__)
+#  define PNG_INTEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#  define PNG_INTEL_TARGET(isa)
+#endif
+
+#ifdef PNG_READ_SUPPORTED
+
+/* The read functions look at most 3 pixels (a,b,c) to predict the 4th (d).
+ * They're positioned like this:
+ *    prev:  c b
+ *    row:   a d
+ * The Sub filter predicts d=a, Avg d=(a+b)/2, and Paeth predicts d to be
+ * whichever of a, b, or c is closest to p=a+b-c.
+ */
+
+PNG_INTEL_TARGET("sse2")
+static __m128i
+load4(const void* p)
+{
+   int tmp;
+   memcpy(&tmp, p, sizeof(tmp));
+   return _mm_cvtsi32_si128(tmp);
+}
+
+PNG_INTEL_TARGET("sse2")
+static void
+store4(void* p, __m128i v)
+{
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, sizeof(int));
+}
+
+PNG_INTEL_TARGET("sse2")
+static __m128i
+load3(const void* p)
+{
+   png_uint_32 tmp = 0;
+   memcpy(&tmp, p, 3);
+   return _mm_cvtsi32_si128((int)tmp);
+}
+
+PNG_INTEL_TARGET("sse2")
+static void
+store3(void* p, __m128i v)
+{
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, 3);
+}
+
+PNG_INTEL_TARGET("sse2")
+void
+png_read_filter_row_sub3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* The Sub filter predicts each pixel as the previous pixel, a.
+    * There is no pixel to the left of the first pixel.  It's encoded directly.
+    * That works with our main loop if we just say that left pixel was zero.
+    */
+   png_size_t rb = row_info->rowbytes;
+
+   __m128i a, d = _mm_setzero_si128();
+
+   PNG_UNUSED(prev)
+
+   while (rb >= 4)
+   {
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, a);
+      store3(row, d);
+
+      row += 3;
+      rb  -= 3;
+   }
+
+   if (rb > 0)
+   {
+      a = d; d = load3(row);
+      d = _mm_add_epi8(d, a);
+      store3(row, d);
+   }
+}
+
+PNG_INTEL_TARGET("sse2")
+void
+png_read_filter_row_sub4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* The Sub filter predicts each pixel as the previous pixel, a.
+    * Just like in sub3, this works with our main loop if we say the left pixel
+    * of the first pixel was zero.
+    */
+   png_size_t rb = row_info->rowbytes + 4;
+
+   __m128i a, d = _mm_setzero_si128();
+
+   PNG_UNUSED(prev)
+
+   while (rb > 4)
+   {
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, a);
+      store4(row, d);
+
+      row += 4;
+      rb  -= 4;
+   }
+}
+
+PNG_INTEL_TARGET("sse2")
+static __m128i
+avg_truncated(__m128i a, __m128i b)
+{
+   /* PNG requires a truncating average, so we can't just use _mm_avg_epu8...
+    * ...but we can fix it up by subtracting off 1 if it rounded up.
+    */
+   __m128i avg = _mm_avg_epu8(a, b);
+   return _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b),
+      _mm_set1_epi8(1)));
+}
+
+PNG_INTEL_TARGET("sse2")
+void
+png_read_filter_row_avg3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* The Avg filter predicts each pixel as the (truncated) average of a and b.
+    * There's no pixel to the left of the first pixel.  Luckily, it's
+    * predicted to be half of the pixel above it.  So again, this works
+    * perfectly with our loop if we make sure a starts at zero.
+    */
+   png_size_t rb = row_info->rowbytes;
+
+   __m128i b;
+   __m128i a, d = _mm_setzero_si128();
+
+   while (rb >= 4)
+   {
+      b = load4(prev);
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, avg_truncated(a, b));
+      store3(row, d);
+
+      prev += 3;
+      row  += 3;
+      rb   -= 3;
+   }
+
+   if (rb > 0)
+   {
+      b = load3(prev);
+      a = d; d = load3(row);
+      d = _mm_add_epi8(d, avg_truncated(a, b));
+      store3(row, d);
+   }
+}
+
+PNG_INTEL_TARGET("sse2")
+void
+png_read_filter_row_avg4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   /* The Avg filter predicts each pixel as the (truncated) average of a and b.
+    * There's no pixel to the left of the first pixel.  Luckily, it's
+    * predicted to be half of the pixel above it.  So again, this works
+    * perfectly with our loop if we make sure a starts at zero.
+    */
+   png_size_t rb = row_info->rowbytes + 4;
+
+   __m128i b;
+   __m128i a, d = _mm_setzero_si128();
+
+   while (rb > 4)
+   {
+      b = load4(prev);
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, avg_truncated(a, b));
+      store4(row, d);
+
+      prev += 4;
+      row  += 4;
+      rb   -= 4;
+   }
+}
+
+/* Returns |x| for 16-bit lanes. */
+PNG_INTEL_TARGET("sse2")
+static __m128i
+abs_i16_sse2(__m128i x)
+{
+   /* Read this all as, return x<0 ? -x : x.
+    * To negate two's complement, you flip all the bits then add 1.
+    */
+   __m128i is_negative = _mm_cmplt_epi16(x, _mm_setzero_si128());
+
+   /* Flip negative lanes. */
+   x = _mm_xor_si128(x, is_negative);
+
+   /* +1 to negative lanes, else +0. */
+   x = _mm_sub_epi16(x, is_negative);
+   return x;
+}
+
+PNG_INTEL_TARGET("ssse3")
+static __m128i
+abs_i16_ssse3(__m128i x)
+{
+   return _mm_abs_epi16(x);
+}
+
+/* Bytewise c ? t : e. */
+PNG_INTEL_TARGET("sse2")
+static __m128i
+if_then_else(__m128i c, __m128i t, __m128i e)
+{
+   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+}
+
+/* Returns whichever of a, b and c is closest to p = a+b-c, given the distances
+ * |p-a| = |b-c|, |p-b| = |a-c| and |p-c| = |(b-c)+(a-c)|.  Ties go to a, then
+ * b, just like the scalar code.
+ */
+PNG_INTEL_TARGET("sse2")
+static __m128i
+paeth_nearest(__m128i a, __m128i b, __m128i c, __m128i pa, __m128i pb,
+   __m128i pc)
+{
+   __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+   return if_then_else(_mm_cmpeq_epi16(smallest, pa), a,
+          if_then_else(_mm_cmpeq_epi16(smallest, pb), b,
+                                                      c));
+}
+
+/* Paeth tries to predict pixel d using the pixel to the left of it, a,
+ * and two pixels from the previous row, b and c:
+ *   prev: c b
+ *   row:  a d
+ * The first pixel has no left context, and so uses an Up filter, p = b.
+ * This works naturally with our main loop's p = a+b-c if we force a and c
+ * to zero.  Here we zero b and d, which become c and a respectively at the
+ * start of the loop.  The math happens in 16-bit lanes; d only ever gets
+ * added bytewise, so its high bytes stay zero.  The two variants differ in
+ * how they take absolute values.
+ */
+#define PNG_PAETH_STEP(abs_i16, load, store) \
+   { \
+      __m128i pa, pb, pc; \
+\
+      c = b; b = _mm_unpacklo_epi8(load(prev), zero); \
+      a = d; d = _mm_unpacklo_epi8(load(row ), zero); \
+\
+      /* (p-a) == (a+b-c - a) == (b-c) */ \
+      pa = _mm_sub_epi16(b, c); \
+\
+      /* (p-b) == (a+b-c - b) == (a-c) */ \
+      pb = _mm_sub_epi16(a, c); \
+\
+      /* (p-c) == (a+b-c - c) == (a+b-c-c) == (b-c)+(a-c) */ \
+      pc = _mm_add_epi16(pa, pb); \
+\
+      pa = abs_i16(pa); \
+      pb = abs_i16(pb); \
+      pc = abs_i16(pc); \
+\
+      d = _mm_add_epi8(d, paeth_nearest(a, b, c, pa, pb, pc)); \
+      store(row, _mm_packus_epi16(d, d)); \
+   }
+
+PNG_INTEL_TARGET("sse2")
+void
+png_read_filter_row_paeth3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   png_size_t rb = row_info->rowbytes;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero, a, d = zero;
+
+   while (rb >= 4)
+   {
+      PNG_PAETH_STEP(abs_i16_sse2, load4, store3)
+      prev += 3;
+      row  += 3;
+      rb   -= 3;
+   }
+
+   if (rb > 0)
+      PNG_PAETH_STEP(abs_i16_sse2, load3, store3)
+}
+
+PNG_INTEL_TARGET("sse2")
+void
+png_read_filter_row_paeth4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   png_size_t rb = row_info->rowbytes + 4;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero, a, d = zero;
+
+   while (rb > 4)
+   {
+      PNG_PAETH_STEP(abs_i16_sse2, load4, store4)
+      prev += 4;
+      row  += 4;
+      rb   -= 4;
+   }
+}
+
+PNG_INTEL_TARGET("ssse3")
+void
+png_read_filter_row_paeth3_ssse3(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   png_size_t rb = row_info->rowbytes;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero, a, d = zero;
+
+   while (rb >= 4)
+   {
+      PNG_PAETH_STEP(abs_i16_ssse3, load4, store3)
+      prev += 3;
+      row  += 3;
+      rb   -= 3;
+   }
+
+   if (rb > 0)
+      PNG_PAETH_STEP(abs_i16_ssse3, load3, store3)
+}
+
+PNG_INTEL_TARGET("ssse3")
+void
+png_read_filter_row_paeth4_ssse3(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   png_size_t rb = row_info->rowbytes + 4;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero, a, d = zero;
+
+   while (rb > 4)
+   {
+      PNG_PAETH_STEP(abs_i16_ssse3, load4, store4)
+      prev += 4;
+      row  += 4;
+      rb   -= 4;
+   }
+}
+
+#endif /* PNG_READ_SUPPORTED */
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+
+/* Writing has the whole unfiltered row at hand, so unlike reading every byte
+ * can be filtered independently, 16 at a time whatever the pixel size is.  The
+ * absolute differences are summed up along the way, checking against the
+ * limit every CHUNK_SIZE bytes.  Bytes work out for Paeth as well: the
+ * distances saturate at 255, which changes none of the comparisons.
+ */
+#define CHUNK_SIZE 256
+
+PNG_INTEL_TARGET("sse2")
+static __m128i
+abs_diff_u8(__m128i x, __m128i y)
+{
+   return _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+}
+
+PNG_INTEL_TARGET("sse2")
+static __m128i
+less_equal_u8(__m128i x, __m128i y)
+{
+   return _mm_cmpeq_epi8(_mm_subs_epu8(x, y), _mm_setzero_si128());
+}
+
+PNG_INTEL_TARGET("sse2")
+static __m128i
+select_u8(__m128i mask, __m128i x, __m128i y)
+{
+   return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+
+PNG_INTEL_TARGET("sse2")
+static __m128i
+paeth_predict_u8(__m128i a, __m128i b, __m128i c)
+{
+   __m128i pa = abs_diff_u8(b, c);
+   __m128i pb = abs_diff_u8(a, c);
+
+   /* |a + b - 2c| is pa + pb if a and b lie on the same side of c, and the
+    * difference of both otherwise.
+    */
+   __m128i same = _mm_cmpeq_epi8(less_equal_u8(b, c), less_equal_u8(a, c));
+   __m128i pc = select_u8(same, _mm_adds_epu8(pa, pb), abs_diff_u8(pa, pb));
+
+   __m128i use_a = _mm_and_si128(less_equal_u8(pa, pb), less_equal_u8(pa, pc));
+   return select_u8(use_a, a, select_u8(less_equal_u8(pb, pc), b, c));
+}
+
+/* One byte the generic way, for the first pixel and the end of the row */
+static png_uint_32
+filter_byte(int filter, png_const_bytep row, png_const_bytep prev,
+   png_bytep dst, png_size_t i, unsigned int bpp)
+{
+   int a = i >= bpp ? row[i - bpp] : 0;
+   int b = 0, c = 0, p, pa, pb, pc;
+   png_byte d;
+
+   /* The none and sub filters are used without a previous row */
+   if (filter >= PNG_FILTER_VALUE_UP)
+   {
+      b = prev[i];
+      c = i >= bpp ? prev[i - bpp] : 0;
+   }
+
+   switch (filter)
+   {
+      case PNG_FILTER_VALUE_SUB:
+         p = a;
+         break;
+
+      case PNG_FILTER_VALUE_UP:
+         p = b;
+         break;
+
+      case PNG_FILTER_VALUE_AVG:
+         p = (a + b) >> 1;
+         break;
+
+      case PNG_FILTER_VALUE_PAETH:
+         pa = abs(b - c);
+         pb = abs(a - c);
+         pc = abs(a + b - c - c);
+         p = (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+         break;
+
+      default:
+         p = 0;
+         break;
+   }
+
+   d = (png_byte)(row[i] - p);
+   if (dst != NULL)
+      dst[i] = d;
+
+   return d < 128 ? d : 256 - d;
+}
+
+PNG_INTEL_TARGET("sse2")
+static png_uint_32
+filter_row_sse2(int filter, png_const_bytep row, png_const_bytep prev,
+   png_bytep dst, png_size_t row_bytes, unsigned int bpp, png_uint_32 limit)
+{
+   const __m128i zero = _mm_setzero_si128();
+   png_uint_32 sum = 0;
+   png_size_t i;
+
+   for (i = 0; i < bpp && i < row_bytes; i++)
+      sum += filter_byte(filter, row, prev, dst, i, bpp);
+
+   while (i + 16 <= row_bytes)
+   {
+      png_size_t end = row_bytes - i > CHUNK_SIZE ? i + CHUNK_SIZE : row_bytes;
+      __m128i acc = zero;
+
+      for (; i + 16 <= end; i += 16)
+      {
+         __m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+         __m128i a, b, p, d;
+
+         switch (filter)
+         {
+            case PNG_FILTER_VALUE_SUB:
+               p = _mm_loadu_si128((const __m128i*)(row + i - bpp));
+               break;
+
+            case PNG_FILTER_VALUE_UP:
+               p = _mm_loadu_si128((const __m128i*)(prev + i));
+               break;
+
+            case PNG_FILTER_VALUE_AVG:
+               /* _mm_avg_epu8 rounds up, the filter rounds down */
+               a = _mm_loadu_si128((const __m128i*)(row + i - bpp));
+               b = _mm_loadu_si128((const __m128i*)(prev + i));
+               p = _mm_sub_epi8(_mm_avg_epu8(a, b),
+                   _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+               break;
+
+            case PNG_FILTER_VALUE_PAETH:
+               p = paeth_predict_u8(
+                   _mm_loadu_si128((const __m128i*)(row + i - bpp)),
+                   _mm_loadu_si128((const __m128i*)(prev + i)),
+                   _mm_loadu_si128((const __m128i*)(prev + i - bpp)));
+               break;
+
+            default:
+               p = zero;
+               break;
+         }
+
+         d = _mm_sub_epi8(x, p);
+         if (dst != NULL)
+            _mm_storeu_si128((__m128i*)(dst + i), d);
+
+         /* min(d, -d) is |d| with d taken as signed */
+         acc = _mm_add_epi64(acc,
+             _mm_sad_epu8(_mm_min_epu8(d, _mm_sub_epi8(zero, d)), zero));
+      }
+
+      sum += (png_uint_32)_mm_cvtsi128_si32(acc) +
+          (png_uint_32)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+
+      if (sum > limit)
+         return sum;
+   }
+
+   for (; i < row_bytes; i++)
+      sum += filter_byte(filter, row, prev, dst, i, bpp);
+
+   return sum;
+}
+
+png_uint_32
+png_write_filter_row_none_sse2(png_const_bytep row, png_const_bytep prev,
+   png_bytep dst, png_size_t row_bytes, unsigned int bpp, png_uint_32 limit)
+{
+   return filter_row_sse2(PNG_FILTER_VALUE_NONE, row, prev, dst, row_bytes,
+       bpp, limit);
+}
+
+png_uint_32
+png_write_filter_row_sub_sse2(png_const_bytep row, png_const_bytep prev,
+   png_bytep dst, png_size_t row_bytes, unsigned int bpp, png_uint_32 limit)
+{
+   return filter_row_sse2(PNG_FILTER_VALUE_SUB, row, prev, dst, row_bytes,
+       bpp, limit);
+}
+
+png_uint_32
+png_write_filter_row_up_sse2(png_const_bytep row, png_const_bytep prev,
+   png_bytep dst, png_size_t row_bytes, unsigned int bpp, png_uint_32 limit)
+{
+   return filter_row_sse2(PNG_FILTER_VALUE_UP, row, prev, dst, row_bytes,
+       bpp, limit);
+}
+
+png_uint_32
+png_write_filter_row_avg_sse2(png_const_bytep row, png_const_bytep prev,
+   png_bytep dst, png_size_t row_bytes, unsigned int bpp, png_uint_32 limit)
+{
+   return filter_row_sse2(PNG_FILTER_VALUE_AVG, row, prev, dst, row_bytes,
+       bpp, limit);
+}
+
+png_uint_32
+png_write_filter_row_paeth_sse2(png_const_bytep row, png_const_bytep prev,
+   png_bytep dst, png_size_t row_bytes, unsigned int bpp, png_uint_32 limit)
+{
+   return filter_row_sse2(PNG_FILTER_VALUE_PAETH, row, prev, dst, row_bytes,
+       bpp, limit);
+}
+
+#endif /* PNG_WRITE_FILTER_SUPPORTED */
+#endif /* PNG_INTEL_SSE_OPT > 0 */
@@ -0,0 +1,113 @@
+
+/* intel_init.c - SSE2 optimized filter functions
+ *
+ * Copyright (c) 2016 Google, Inc.
+ * Written by Mike Klein and Matt Sarett
+ * Derived from arm/arm_init.c, 2014 Glenn Randers-Pehrson
+ * Backported to libpng 1.6.10, with run time CPU detection
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#if PNG_INTEL_SSE_OPT > 0
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#else
+#  include <cpuid.h>
+#endif
+
+#define PNG_INTEL_SSE2  1
+#define PNG_INTEL_SSSE3 2
+
+static int
+png_intel_cpu_features(void)
+{
+   /* Neither SSE2 nor SSSE3 use any state the operating system has to save,
+    * so the CPUID bits are all that needs checking.
+    */
+   unsigned int ecx, edx;
+   int features = 0;
+
+#if defined(_MSC_VER)
+   int regs[4];
+
+   __cpuid(regs, 1);
+   ecx = (unsigned int)regs[2];
+   edx = (unsigned int)regs[3];
+#else
+   unsigned int eax, ebx;
+
+   if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+      return 0;
+#endif
+
+   if ((edx & (1U << 26)) != 0)
+   {
+      features |= PNG_INTEL_SSE2;
+
+      if ((ecx & (1U << 9)) != 0)
+         features |= PNG_INTEL_SSSE3;
+   }
+
+   return features;
+}
+
+#ifdef PNG_READ_SUPPORTED
+void
+png_init_filter_functions_sse2(png_structp pp, unsigned int bpp)
+{
+   /* The techniques used to implement each of these filters in SSE operate on
+    * one pixel at a time.  So they generally speed up 3bpp images about 3x,
+    * 4bpp images about 4x.  They can scale up to 6 and 8 bpp images and down to
+    * 2 bpp images, but they'd not likely have any benefit, since they'd process
+    * even fewer bytes at a time.  Up is left to the compiler, which vectorizes
+    * the generic loop by itself.  AVX2 is of no use here: every pixel depends
+    * on the one before it, and a pixel fits into a single SSE register.
+    */
+   int features = png_intel_cpu_features();
+
+   if ((features & PNG_INTEL_SSE2) == 0)
+      return;
+
+   if (bpp == 3)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub3_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg3_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         (features & PNG_INTEL_SSSE3) != 0 ?
+         png_read_filter_row_paeth3_ssse3 : png_read_filter_row_paeth3_sse2;
+   }
+   else if (bpp == 4)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub4_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg4_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         (features & PNG_INTEL_SSSE3) != 0 ?
+         png_read_filter_row_paeth4_ssse3 : png_read_filter_row_paeth4_sse2;
+   }
+}
+#endif /* PNG_READ_SUPPORTED */
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+void
+png_init_write_filter_functions_sse2(png_structp pp)
+{
+   /* The write filters work on 16 bytes at a time for any pixel size, see
+    * filter_sse2_intrinsics.c.
+    */
+   if ((png_intel_cpu_features() & PNG_INTEL_SSE2) == 0)
+      return;
+
+   pp->write_filter[PNG_FILTER_VALUE_NONE] = png_write_filter_row_none_sse2;
+   pp->write_filter[PNG_FILTER_VALUE_SUB] = png_write_filter_row_sub_sse2;
+   pp->write_filter[PNG_FILTER_VALUE_UP] = png_write_filter_row_up_sse2;
+   pp->write_filter[PNG_FILTER_VALUE_AVG] = png_write_filter_row_avg_sse2;
+   pp->write_filter[PNG_FILTER_VALUE_PAETH] = png_write_filter_row_paeth_sse2;
+}
+#endif /* PNG_WRITE_FILTER_SUPPORTED */
+#endif /* PNG_INTEL_SSE_OPT > 0 */
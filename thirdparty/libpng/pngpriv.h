@@ -176,6 +176,28 @@
 #  endif
 #endif /* PNG_ARM_NEON_OPT > 0 */
 
+#ifndef PNG_INTEL_SSE_OPT
+   /* Intel SSE2 and SSSE3 optimizations (backported from libpng 1.6.x, see
+    * intel/filter_sse2_intrinsics.c).  Unlike upstream they do not depend on
+    * the compiler settings: each function is compiled for its own instruction
+    * set and intel/intel_init.c picks the best one the CPU supports at run
+    * time.  Define PNG_INTEL_SSE_OPT to 0 in CPPFLAGS to build without them.
+    */
+#  if (defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+      defined(_M_X64)) && (defined(__GNUC__) || defined(_MSC_VER))
+#     define PNG_INTEL_SSE_OPT 1
+#  else
+#     define PNG_INTEL_SSE_OPT 0
+#  endif
+#endif
+
+#if PNG_INTEL_SSE_OPT > 0
+#  define PNG_FILTER_OPTIMIZATIONS png_init_filter_functions_sse2
+#  ifdef PNG_WRITE_FILTER_SUPPORTED
+#     define PNG_WRITE_FILTER_OPTIMIZATIONS png_init_write_filter_functions_sse2
+#  endif
+#endif
+
 /* Is this a build of a DLL where compilation of the object modules requires
  * different preprocessor settings to those required for a simple library?  If
  * so PNG_BUILD_DLL must be set.
@@ -1204,6 +1226,45 @@ PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_neon,(png_row_infop
 PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_neon,(png_row_infop
     row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
 
+#if PNG_INTEL_SSE_OPT > 0
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub3_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_sub4_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg3_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_avg4_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_sse2,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth3_ssse3,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void,png_read_filter_row_paeth4_ssse3,(png_row_infop
+    row_info, png_bytep row, png_const_bytep prev_row),PNG_EMPTY);
+
+/* Filter a whole row for writing and return the sum of absolute differences
+ * of the result; these may stop early once the sum exceeds 'limit'.  The
+ * none filter only sums, 'dst' is NULL for it.
+ */
+PNG_INTERNAL_FUNCTION(png_uint_32,png_write_filter_row_none_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep dst,
+    png_size_t row_bytes, unsigned int bpp, png_uint_32 limit),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(png_uint_32,png_write_filter_row_sub_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep dst,
+    png_size_t row_bytes, unsigned int bpp, png_uint_32 limit),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(png_uint_32,png_write_filter_row_up_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep dst,
+    png_size_t row_bytes, unsigned int bpp, png_uint_32 limit),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(png_uint_32,png_write_filter_row_avg_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep dst,
+    png_size_t row_bytes, unsigned int bpp, png_uint_32 limit),PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(png_uint_32,png_write_filter_row_paeth_sse2,
+    (png_const_bytep row, png_const_bytep prev_row, png_bytep dst,
+    png_size_t row_bytes, unsigned int bpp, png_uint_32 limit),PNG_EMPTY);
+#endif
+
 /* Choose the best filter to use and filter the row data */
 PNG_INTERNAL_FUNCTION(void,png_write_find_filter,(png_structrp png_ptr,
     png_row_infop row_info),PNG_EMPTY);
@@ -1926,6 +1987,16 @@ PNG_INTERNAL_FUNCTION(void, PNG_FILTER_OPTIMIZATIONS, (png_structp png_ptr,
     */
 PNG_INTERNAL_FUNCTION(void, png_init_filter_functions_neon,
    (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+PNG_INTERNAL_FUNCTION(void, png_init_filter_functions_sse2,
+   (png_structp png_ptr, unsigned int bpp), PNG_EMPTY);
+#endif
+
+/* The same for the write side, PNG_WRITE_FILTER_OPTIMIZATIONS fills in the
+ * png_ptr->write_filter[] array; the generic code is used if it stays empty.
+ */
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+PNG_INTERNAL_FUNCTION(void, PNG_WRITE_FILTER_OPTIMIZATIONS,
+   (png_structp png_ptr), PNG_EMPTY);
 #endif
 
 /* Maintainer: Put new private prototypes here ^ */
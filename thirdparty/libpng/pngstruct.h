@@ -359,7 +359,7 @@ struct png_struct_def
 
    /* Options */
 #ifdef PNG_SET_OPTION_SUPPORTED
-   png_byte options;           /* On/off state (up to 4 options) */
+   png_uint_32 options;        /* On/off state (up to 16 options) */
 #endif
 
 #if PNG_LIBPNG_VER < 10700
@@ -480,6 +480,13 @@ struct png_struct_def
    void (*read_filter[PNG_FILTER_VALUE_LAST-1])(png_row_infop row_info,
       png_bytep row, png_const_bytep prev_row);
 
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+/* Added in the bundled copy: optional write filters, indexed by filter value */
+   png_uint_32 (*write_filter[PNG_FILTER_VALUE_LAST])(png_const_bytep row,
+      png_const_bytep prev_row, png_bytep dst, png_size_t row_bytes,
+      unsigned int bpp, png_uint_32 limit);
+#endif
+
 #ifdef PNG_READ_SUPPORTED
 #if defined(PNG_COLORSPACE_SUPPORTED) || defined(PNG_GAMMA_SUPPORTED)
    png_colorspace   colorspace;
@@ -2010,6 +2010,10 @@ png_write_start_row(png_structrp png_ptr)
          png_ptr->paeth_row[0] = PNG_FILTER_VALUE_PAETH;
       }
    }
+
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   PNG_WRITE_FILTER_OPTIMIZATIONS(png_ptr);
+#endif
 #endif /* PNG_WRITE_FILTER_SUPPORTED */
 
 #ifdef PNG_WRITE_INTERLACING_SUPPORTED
@@ -2317,6 +2321,57 @@ png_write_filtered_row(png_structrp png_ptr, png_bytep filtered_row,
 #define PNG_HISHIFT 10
 #define PNG_LOMASK ((png_uint_32)0xffffL)
 #define PNG_HIMASK ((png_uint_32)(~PNG_LOMASK >> PNG_HISHIFT))
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+/* The unweighted heuristic of png_write_find_filter with the functions from
+ * png_ptr->write_filter[], which pick the same filters the generic code does.
+ */
+static png_bytep
+png_write_find_filter_optimized(png_structrp png_ptr, png_byte filter_to_do,
+    png_size_t row_bytes, unsigned int bpp)
+{
+   png_bytep rows[PNG_FILTER_VALUE_LAST];
+   png_bytep best_row = png_ptr->row_buf;
+   png_uint_32 mins = PNG_MAXSUM;
+   int filter;
+
+   rows[PNG_FILTER_VALUE_NONE] = png_ptr->row_buf;
+   rows[PNG_FILTER_VALUE_SUB] = png_ptr->sub_row;
+   rows[PNG_FILTER_VALUE_UP] = png_ptr->up_row;
+   rows[PNG_FILTER_VALUE_AVG] = png_ptr->avg_row;
+   rows[PNG_FILTER_VALUE_PAETH] = png_ptr->paeth_row;
+
+   if ((filter_to_do & PNG_FILTER_NONE) && filter_to_do != PNG_FILTER_NONE)
+      mins = png_ptr->write_filter[PNG_FILTER_VALUE_NONE](png_ptr->row_buf + 1,
+          NULL, NULL, row_bytes, bpp, (png_uint_32)-1);
+
+   for (filter = PNG_FILTER_VALUE_SUB; filter < PNG_FILTER_VALUE_LAST; filter++)
+   {
+      png_byte flag = (png_byte)(PNG_FILTER_NONE << filter);
+      png_bytep prev_row = png_ptr->prev_row;
+      png_uint_32 sum;
+
+      if (!(filter_to_do & flag))
+         continue;
+
+      sum = png_ptr->write_filter[filter](png_ptr->row_buf + 1,
+          prev_row != NULL ? prev_row + 1 : NULL, rows[filter] + 1, row_bytes,
+          bpp, filter_to_do == flag ? (png_uint_32)-1 : mins);
+
+      /* It's the only filter so no testing is needed */
+      if (filter_to_do == flag)
+         return rows[filter];
+
+      if (sum < mins)
+      {
+         mins = sum;
+         best_row = rows[filter];
+      }
+   }
+
+   return best_row;
+}
+#endif
+
 void /* PRIVATE */
 png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
 {
@@ -2350,6 +2405,20 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
    row_buf = best_row;
    mins = PNG_MAXSUM;
 
+#ifdef PNG_WRITE_FILTER_OPTIMIZATIONS
+   /* The optimized filters leave nothing to do for the generic code below */
+   if (png_ptr->write_filter[PNG_FILTER_VALUE_NONE] != NULL
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+       && png_ptr->heuristic_method != PNG_FILTER_HEURISTIC_WEIGHTED
+#endif
+      )
+   {
+      best_row = png_write_find_filter_optimized(png_ptr, filter_to_do,
+          row_bytes, bpp);
+      filter_to_do = 0;
+   }
+#endif
+
    /* The prediction method we use is to find which method provides the
     * smallest value when summing the absolute values of the distances
     * from zero, using anything >= 128 as negative numbers.  This is known